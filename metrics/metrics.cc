@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+#include "metrics/metrics.h"
+
+namespace metrics {
+
+size_t Counter::ThreadShard() {
+  static std::atomic<size_t> next{0};
+  thread_local const size_t shard =
+      next.fetch_add(1, std::memory_order_relaxed) % kShards;
+  return shard;
+}
+
+const uint64_t Counter::Value() const {
+  uint64_t total = 0;
+  for (const Shard &shard : shards_) {
+    total += shard.value.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+size_t Histogram::BucketOf(const uint64_t value) {
+  // Values below kSubBuckets get one bucket each. Above, the position of the
+  // highest set bit picks the power of two and the next kSubBucketBits bits
+  // the linear bucket inside it.
+  if (value < kSubBuckets) {
+    return static_cast<size_t>(value);
+  }
+  const int exponent = std::bit_width(value) - 1;
+  const int shift = exponent - kSubBucketBits;
+  const size_t sub = static_cast<size_t>(value >> shift) & (kSubBuckets - 1);
+  return static_cast<size_t>(shift + 1) * kSubBuckets + sub;
+}
+
+uint64_t Histogram::LowerBound(const size_t bucket) {
+  if (bucket < kSubBuckets) {
+    return bucket;
+  }
+  const int shift = static_cast<int>(bucket / kSubBuckets) - 1;
+  const uint64_t sub = bucket % kSubBuckets;
+  return (kSubBuckets | sub) << shift;
+}
+
+void Histogram::Record(const uint64_t value) {
+  buckets_[BucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+  uint64_t max = max_.load(std::memory_order_relaxed);
+  while (value > max &&
+         !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+  }
+}
+
+HistogramSnapshot Histogram::Snapshot() const {
+  std::array<uint64_t, kNumBuckets> counts;
+  HistogramSnapshot snapshot;
+  for (size_t i = 0; i < kNumBuckets; ++i) {
+    counts[i] = buckets_[i].load(std::memory_order_relaxed);
+    snapshot.count += counts[i];
+  }
+  snapshot.sum = sum_.load(std::memory_order_relaxed);
+  snapshot.max = max_.load(std::memory_order_relaxed);
+
+  // Each percentile is the lower bound of the bucket holding its rank,
+  // capped by the maximum seen.
+  const auto percentile = [&](const double p) -> uint64_t {
+    if (snapshot.count == 0) {
+      return 0;
+    }
+    const uint64_t rank = std::max<uint64_t>(
+        1, static_cast<uint64_t>(p * static_cast<double>(snapshot.count) +
+                                 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kNumBuckets; ++i) {
+      seen += counts[i];
+      if (seen >= rank) {
+        return std::min(LowerBound(i), snapshot.max);
+      }
+    }
+    return snapshot.max;
+  };
+  snapshot.p50 = percentile(0.5);
+  snapshot.p90 = percentile(0.9);
+  snapshot.p99 = percentile(0.99);
+  snapshot.p999 = percentile(0.999);
+  return snapshot;
+}
+
+std::string Snapshot::ToString() const {
+  std::ostringstream out;
+  for (const auto &[name, value] : counters) {
+    out << name << " " << value << "\n";
+  }
+  for (const auto &[name, h] : histograms) {
+    out << name << " count=" << h.count << " mean=" << h.Mean()
+        << " p50=" << h.p50 << " p90=" << h.p90 << " p99=" << h.p99
+        << " p999=" << h.p999 << " max=" << h.max << "\n";
+  }
+  return out.str();
+}
+
+Registry &Registry::Global() {
+  // Leaked, so metrics can still be reported from static destructors.
+  static Registry *registry = new Registry();
+  return *registry;
+}
+
+Counter &Registry::GetCounter(const std::string &name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto &counter = counters_[name];
+  if (!counter) {
+    counter = std::make_unique<Counter>();
+  }
+  return *counter;
+}
+
+Histogram &Registry::GetHistogram(const std::string &name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto &histogram = histograms_[name];
+  if (!histogram) {
+    histogram = std::make_unique<Histogram>();
+  }
+  return *histogram;
+}
+
+Snapshot Registry::TakeSnapshot() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Snapshot snapshot;
+  for (const auto &[name, counter] : counters_) {
+    snapshot.counters[name] = counter->Value();
+  }
+  for (const auto &[name, histogram] : histograms_) {
+    snapshot.histograms[name] = histogram->Snapshot();
+  }
+  return snapshot;
+}
+
+} // namespace metrics
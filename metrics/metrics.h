@@ -0,0 +1,160 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace metrics {
+
+// Nanoseconds on the steady clock.
+inline uint64_t NowNs() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+// Monotonic counter sharded by thread.
+//
+// Every thread adds to its own cache line (threads beyond kShards share
+// lines), so hot-path increments do not bounce a shared line. Value() sums
+// the shards.
+class Counter {
+public:
+  static constexpr size_t kShards = 64;
+
+  Counter() = default;
+
+  void Add(const uint64_t n = 1) {
+    shards_[ThreadShard()].value.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  const uint64_t Value() const;
+
+  Counter(const Counter &) = delete;
+  Counter &operator=(const Counter &) = delete;
+
+private:
+  struct alignas(64) Shard {
+    std::atomic<uint64_t> value{0};
+  };
+
+  static size_t ThreadShard();
+
+  std::array<Shard, kShards> shards_;
+};
+
+// Summary of a Histogram at one point in time.
+struct HistogramSnapshot {
+  uint64_t count = 0;
+  uint64_t sum = 0;
+  uint64_t max = 0;
+  uint64_t p50 = 0;
+  uint64_t p90 = 0;
+  uint64_t p99 = 0;
+  uint64_t p999 = 0;
+
+  const double Mean() const {
+    return count == 0 ? 0.0 : static_cast<double>(sum) / count;
+  }
+};
+
+// Histogram of non-negative integers (e.g. latencies in nanoseconds) with
+// HDR-style log-linear buckets: every power of two is split into
+// kSubBuckets linear buckets, so a recorded value is off by at most 1 /
+// kSubBuckets (12.5%) over the whole uint64_t range, in a fixed 4KiB.
+class Histogram {
+public:
+  static constexpr int kSubBucketBits = 3;
+  static constexpr size_t kSubBuckets = size_t{1} << kSubBucketBits;
+  static constexpr size_t kNumBuckets = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+  Histogram() = default;
+
+  void Record(const uint64_t value);
+
+  HistogramSnapshot Snapshot() const;
+
+  // Smallest value of the bucket of `value`.
+  static uint64_t LowerBound(const size_t bucket);
+  static size_t BucketOf(const uint64_t value);
+
+  Histogram(const Histogram &) = delete;
+  Histogram &operator=(const Histogram &) = delete;
+
+private:
+  std::array<std::atomic<uint64_t>, kNumBuckets> buckets_{};
+  std::atomic<uint64_t> sum_{0};
+  std::atomic<uint64_t> max_{0};
+};
+
+// Values of every registered metric.
+struct Snapshot {
+  std::map<std::string, uint64_t> counters;
+  std::map<std::string, HistogramSnapshot> histograms;
+
+  // One "name value" line per counter and one summary line per histogram.
+  std::string ToString() const;
+};
+
+// Named metrics. Lookups take a lock, so hot paths look a metric up once and
+// keep the reference (the LFWP_METRIC_* macros do). Metrics live as long as
+// the registry.
+class Registry {
+public:
+  Registry() = default;
+
+  // Registry the LFWP_METRIC_* macros report to.
+  static Registry &Global();
+
+  Counter &GetCounter(const std::string &name);
+  Histogram &GetHistogram(const std::string &name);
+
+  Snapshot TakeSnapshot() const;
+
+  Registry(const Registry &) = delete;
+  Registry &operator=(const Registry &) = delete;
+
+private:
+  mutable std::mutex mutex_;
+  std::map<std::string, std::unique_ptr<Counter>> counters_;
+  std::map<std::string, std::unique_ptr<Histogram>> histograms_;
+};
+
+} // namespace metrics
+
+// Instrumentation hooks. They only exist in builds with LFWP_ENABLE_METRICS
+// defined (bazel build --config=metrics); otherwise they expand to nothing
+// and their arguments are not evaluated.
+#ifdef LFWP_ENABLE_METRICS
+
+#define LFWP_METRIC_COUNT(name, n)                                             \
+  do {                                                                         \
+    static ::metrics::Counter &lfwp_counter_ =                                 \
+        ::metrics::Registry::Global().GetCounter(name);                        \
+    lfwp_counter_.Add(n);                                                      \
+  } while (0)
+
+#define LFWP_METRIC_RECORD(name, value)                                        \
+  do {                                                                         \
+    static ::metrics::Histogram &lfwp_histogram_ =                             \
+        ::metrics::Registry::Global().GetHistogram(name);                      \
+    lfwp_histogram_.Record(value);                                             \
+  } while (0)
+
+#else
+
+#define LFWP_METRIC_COUNT(name, n)                                             \
+  do {                                                                         \
+  } while (0)
+
+#define LFWP_METRIC_RECORD(name, value)                                        \
+  do {                                                                         \
+  } while (0)
+
+#endif
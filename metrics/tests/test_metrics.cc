@@ -0,0 +1,80 @@
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+#include "metrics/metrics.h"
+
+TEST(CounterTest, SumsShards) {
+  metrics::Counter counter;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&counter] {
+      for (int i = 0; i < 10000; ++i) {
+        counter.Add();
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  counter.Add(5);
+  EXPECT_EQ(counter.Value(), 80005);
+}
+
+TEST(HistogramTest, BucketsCoverEveryValue) {
+  // Small values are exact; every bucket starts where the previous one ends.
+  for (uint64_t v = 0; v < metrics::Histogram::kSubBuckets; ++v) {
+    EXPECT_EQ(metrics::Histogram::BucketOf(v), v);
+  }
+  for (size_t b = 1; b < metrics::Histogram::kNumBuckets; ++b) {
+    const uint64_t lower = metrics::Histogram::LowerBound(b);
+    EXPECT_EQ(metrics::Histogram::BucketOf(lower), b);
+    EXPECT_EQ(metrics::Histogram::BucketOf(lower - 1), b - 1);
+  }
+  EXPECT_EQ(metrics::Histogram::BucketOf(UINT64_MAX),
+            metrics::Histogram::kNumBuckets - 1);
+}
+
+TEST(HistogramTest, Percentiles) {
+  metrics::Histogram histogram;
+  EXPECT_EQ(histogram.Snapshot().count, 0);
+  for (uint64_t v = 1; v <= 1000; ++v) {
+    histogram.Record(v);
+  }
+  const metrics::HistogramSnapshot snapshot = histogram.Snapshot();
+  EXPECT_EQ(snapshot.count, 1000);
+  EXPECT_EQ(snapshot.sum, 500500);
+  EXPECT_EQ(snapshot.max, 1000);
+  EXPECT_DOUBLE_EQ(snapshot.Mean(), 500.5);
+  // Within one bucket (12.5%) below the exact value.
+  EXPECT_LE(snapshot.p50, 500);
+  EXPECT_GE(snapshot.p50, 500 * 7 / 8);
+  EXPECT_LE(snapshot.p99, 990);
+  EXPECT_GE(snapshot.p99, 990 * 7 / 8);
+  EXPECT_LE(snapshot.p999, 1000);
+}
+
+TEST(RegistryTest, Snapshot) {
+  metrics::Registry registry;
+  metrics::Counter &counter = registry.GetCounter("requests");
+  EXPECT_EQ(&registry.GetCounter("requests"), &counter);
+  counter.Add(3);
+  registry.GetHistogram("latency_ns").Record(100);
+
+  const metrics::Snapshot snapshot = registry.TakeSnapshot();
+  EXPECT_EQ(snapshot.counters.at("requests"), 3);
+  EXPECT_EQ(snapshot.histograms.at("latency_ns").count, 1);
+  EXPECT_NE(snapshot.ToString().find("requests 3"), std::string::npos);
+}
+
+#ifndef LFWP_ENABLE_METRICS
+TEST(RegistryTest, HooksCompileToNothing) {
+  int evaluated = 0;
+  LFWP_METRIC_COUNT("never", ++evaluated);
+  LFWP_METRIC_RECORD("never", ++evaluated);
+  EXPECT_EQ(evaluated, 0);
+  EXPECT_EQ(metrics::Registry::Global().TakeSnapshot().counters.count("never"),
+            0);
+}
+#endif
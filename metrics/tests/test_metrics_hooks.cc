@@ -0,0 +1,105 @@
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+#include "metrics/metrics.h"
+#include "work_pool/lock_free_mpmc.h"
+#include "work_pool/thread_pool.h"
+
+#ifndef LFWP_ENABLE_METRICS
+#error "test_metrics_hooks must be built with LFWP_ENABLE_METRICS"
+#endif
+
+static_assert(sizeof(work_pool::Task) == 64,
+              "The enqueue timestamp must fit in the task's padding");
+
+TEST(MetricsHooksTest, ThreadPoolReportsTasks) {
+  constexpr int kTasks = 100;
+  work_pool::MPMCTaskStore store;
+  {
+    work_pool::ThreadPool pool(store, 2);
+    pool.Start();
+    std::vector<std::future<void>> futures;
+    for (int i = 0; i < kTasks; ++i) {
+      futures.push_back(store.SubmitAndGetFuture(
+          [] { std::this_thread::sleep_for(std::chrono::microseconds(10)); }));
+    }
+    for (auto &future : futures) {
+      future.get();
+    }
+    const std::vector<double> utilization = pool.Utilization();
+    EXPECT_EQ(utilization.size(), 2);
+    for (const double u : utilization) {
+      EXPECT_GE(u, 0.0);
+      EXPECT_LE(u, 1.0);
+    }
+  }
+
+  const metrics::Snapshot snapshot =
+      metrics::Registry::Global().TakeSnapshot();
+  EXPECT_EQ(snapshot.counters.at("task_store.enqueued"), kTasks);
+  EXPECT_EQ(snapshot.histograms.at("thread_pool.task_run_ns").count, kTasks);
+  EXPECT_GE(snapshot.histograms.at("thread_pool.task_run_ns").p50, 10000);
+  EXPECT_EQ(snapshot.histograms.at("thread_pool.task_wait_ns").count, kTasks);
+  EXPECT_EQ(snapshot.counters.at("thread_pool.workers_added"), 2);
+}
+
+/**
+ * A worker that retires and is reaped when the pool grows again keeps its
+ * time in the utilization of its slot, even though the new worker in that
+ * slot has not run anything yet.
+ */
+TEST(MetricsHooksTest, UtilizationKeepsReapedWorkers) {
+  work_pool::MPMCTaskStore store;
+  work_pool::ThreadPool pool(
+      store, work_pool::ElasticPolicy{
+                 .min_threads = 1,
+                 .max_threads = 2,
+                 .idle_timeout = std::chrono::milliseconds(20),
+                 .watchdog_interval = std::chrono::hours(1)});
+  pool.Start();
+
+  // Two blocking tasks that wait for each other grow the pool to two.
+  std::atomic<int> arrived{0};
+  std::vector<std::future<void>> futures;
+  for (int i = 0; i < 2; ++i) {
+    futures.push_back(store.SubmitAndGetFuture([&] {
+      work_pool::BlockingRegion blocking;
+      arrived.fetch_add(1);
+      while (arrived.load() < 2) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }));
+  }
+  for (auto &future : futures) {
+    future.get();
+  }
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (pool.NumThreads() > 1 &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  ASSERT_EQ(pool.NumThreads(), 1);
+
+  // Growing again reaps the retired worker and reuses its slot.
+  store
+      .SubmitAndGetFuture([&] {
+        work_pool::BlockingRegion blocking;
+        while (pool.NumThreads() < 2) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+      })
+      .get();
+
+  const std::vector<double> utilization = pool.Utilization();
+  ASSERT_EQ(utilization.size(), 2);
+  for (const double u : utilization) {
+    EXPECT_GT(u, 0.0);
+    EXPECT_LE(u, 1.0);
+  }
+}
@@ -0,0 +1,99 @@
+#include "signal_tree/signal_tree.h"
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <thread>
+
+namespace {
+
+using Layout = signal_tree::SignalTree::Layout;
+
+std::unique_ptr<signal_tree::SignalTree> tree;
+
+// Same pattern as MultiThreadContentionStress: every thread acquires a leaf,
+// does a little work, releases it and yields when the tree is exhausted.
+// Arguments: {layout, leaves}.
+void BM_ContentionStress(benchmark::State &state) {
+  if (state.thread_index() == 0) {
+    tree = std::make_unique<signal_tree::SignalTree>(
+        static_cast<size_t>(state.range(1)),
+        static_cast<Layout>(state.range(0)));
+  }
+
+  int64_t failed = 0;
+  for (auto _ : state) {
+    const int leaf = tree->Acquire();
+    if (leaf != -1) {
+      benchmark::DoNotOptimize(leaf);
+      tree->Release(leaf);
+    } else {
+      ++failed;
+      std::this_thread::yield();
+    }
+  }
+
+  state.counters["failed"] = benchmark::Counter(
+      static_cast<double>(failed), benchmark::Counter::kAvgIterations);
+  state.SetLabel(state.range(0) == static_cast<int64_t>(Layout::kPadded)
+                     ? "padded"
+                     : "eytzinger");
+  if (state.thread_index() == 0) {
+    tree.reset();
+  }
+}
+
+// Threads hold a leaf for a while, so releases of neighbouring leaves overlap
+// with descents of other threads. Arguments: {layout, leaves}.
+void BM_HoldAndRelease(benchmark::State &state) {
+  if (state.thread_index() == 0) {
+    tree = std::make_unique<signal_tree::SignalTree>(
+        static_cast<size_t>(state.range(1)),
+        static_cast<Layout>(state.range(0)));
+  }
+
+  int held[8];
+  int64_t acquired = 0;
+  for (auto _ : state) {
+    int n = 0;
+    for (; n < 8; ++n) {
+      held[n] = tree->Acquire();
+      if (held[n] == -1) {
+        break;
+      }
+    }
+    for (int i = 0; i < n; ++i) {
+      tree->Release(held[i]);
+    }
+    acquired += n;
+  }
+
+  state.SetItemsProcessed(acquired);
+  state.SetLabel(state.range(0) == static_cast<int64_t>(Layout::kPadded)
+                     ? "padded"
+                     : "eytzinger");
+  if (state.thread_index() == 0) {
+    tree.reset();
+  }
+}
+
+void LayoutArgs(benchmark::internal::Benchmark *b) {
+  for (auto layout : {Layout::kEytzinger, Layout::kPadded}) {
+    for (int64_t leaves : {4, 64, 4096}) {
+      b->Args({static_cast<int64_t>(layout), leaves});
+    }
+  }
+}
+
+} // namespace
+
+BENCHMARK(BM_ContentionStress)
+    ->Apply(LayoutArgs)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+BENCHMARK(BM_HoldAndRelease)
+    ->Apply(LayoutArgs)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
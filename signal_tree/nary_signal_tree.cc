@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <stdexcept>
+
+#include "signal_tree/nary_signal_tree.h"
+
+namespace signal_tree {
+
+NarySignalTree::NarySignalTree(const size_t capacity) : capacity_(capacity) {
+  assert(capacity > 0);
+
+  const size_t num_words = (capacity + kLeavesPerWord - 1) / kLeavesPerWord;
+  words_.reset(new Word[num_words]);
+
+  // Mark every leaf free; the last word only gets the bits that map to leaves.
+  for (size_t w = 0; w < num_words; ++w) {
+    const size_t leaves = std::min(kLeavesPerWord, capacity - w * kLeavesPerWord);
+    const uint64_t bits =
+        leaves == kLeavesPerWord ? ~uint64_t{0} : (uint64_t{1} << leaves) - 1;
+    words_[w].bits.store(bits, std::memory_order_relaxed);
+  }
+
+  // Build counter levels bottom-up until a single node covers everything.
+  size_t children = num_words;
+  do {
+    const size_t nodes = (children + kFanout - 1) / kFanout;
+    std::unique_ptr<Node[]> level(new Node[nodes]);
+    for (size_t c = 0; c < children; ++c) {
+      int32_t count = 0;
+      if (levels_.empty()) {
+        count = __builtin_popcountll(
+            words_[c].bits.load(std::memory_order_relaxed));
+      } else {
+        for (const auto &n : levels_.back()[c].count) {
+          count += n.load(std::memory_order_relaxed);
+        }
+      }
+      level[c / kFanout].count[c % kFanout].store(count,
+                                                  std::memory_order_relaxed);
+    }
+    levels_.push_back(std::move(level));
+    children = nodes;
+  } while (children > 1);
+
+  free_.store(static_cast<int>(capacity), std::memory_order_release);
+}
+
+size_t NarySignalTree::ClaimChild(Node &node) {
+  // Release() publishes a leaf bottom-up and Acquire() reserves top-down, so
+  // a unit reserved on the parent is always present in one of the children.
+  // A failed pass only means another acquirer took a unit first.
+  while (true) {
+    for (size_t i = 0; i < kFanout; ++i) {
+      int32_t count = node.count[i].load(std::memory_order_relaxed);
+      while (count > 0) {
+        if (node.count[i].compare_exchange_weak(count, count - 1,
+                                                std::memory_order_acq_rel)) {
+          return i;
+        }
+      }
+    }
+  }
+}
+
+const int NarySignalTree::Acquire() {
+  // Reserve one leaf at the root.
+  int free = free_.load(std::memory_order_relaxed);
+  do {
+    if (free <= 0) {
+      return -1;
+    }
+  } while (!free_.compare_exchange_weak(free, free - 1,
+                                        std::memory_order_seq_cst));
+
+  size_t child = 0;
+  for (size_t level = levels_.size(); level-- > 0;) {
+    child = child * kFanout + ClaimChild(levels_[level][child]);
+  }
+
+  // The reservation guarantees a set bit in this word; retry only if another
+  // acquirer cleared the bit we picked.
+  std::atomic<uint64_t> &word = words_[child].bits;
+  uint64_t bits = word.load(std::memory_order_acquire);
+  while (true) {
+    assert(bits != 0);
+    const uint64_t mask = uint64_t{1} << __builtin_ctzll(bits);
+    bits = word.fetch_and(~mask, std::memory_order_acq_rel);
+    if (bits & mask) {
+      return static_cast<int>(child * kLeavesPerWord +
+                              __builtin_ctzll(mask));
+    }
+  }
+}
+
+void NarySignalTree::Release(const int &index) {
+  if (index < 0 || static_cast<size_t>(index) >= capacity_) {
+    throw std::runtime_error("Release() called with invalid index!");
+  }
+
+  // Mark leaf as free: 0 -> 1
+  size_t child = static_cast<size_t>(index) / kLeavesPerWord;
+  const uint64_t mask = uint64_t{1} << (index % kLeavesPerWord);
+  if (words_[child].bits.fetch_or(mask, std::memory_order_acq_rel) & mask) {
+    throw std::runtime_error("Releasing a leaf that was already free!");
+  }
+
+  // Propagate +1 up the counters, then to the root.
+  for (auto &level : levels_) {
+    level[child / kFanout].count[child % kFanout].fetch_add(
+        1, std::memory_order_acq_rel);
+    child /= kFanout;
+  }
+  free_.fetch_add(1, std::memory_order_seq_cst);
+}
+
+} // namespace signal_tree
@@ -0,0 +1,188 @@
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "signal_tree/resizable_signal_tree.h"
+
+namespace signal_tree {
+
+namespace {
+
+// Shard of the calling thread: threads are spread round-robin.
+size_t ShardIndex(const size_t shards) {
+  static std::atomic<size_t> next_shard{0};
+  thread_local const size_t shard =
+      next_shard.fetch_add(1, std::memory_order_relaxed);
+  return shard % shards;
+}
+
+} // namespace
+
+ResizableSignalTree::Guard::Guard(const ResizableSignalTree &owner)
+    : active_(owner.shards_[ShardIndex(kShards)]
+                  .active[owner.epoch_.load(std::memory_order_seq_cst) & 1]) {
+  // The seq_cst increment before the load pairs with the seq_cst store and
+  // counter checks in Resize(): either Resize() sees this operation, or this
+  // operation sees the tree Resize() published.
+  active_.fetch_add(1, std::memory_order_seq_cst);
+  tree_ = owner.current_.load(std::memory_order_seq_cst);
+}
+
+ResizableSignalTree::Guard::~Guard() {
+  active_.fetch_sub(1, std::memory_order_release);
+}
+
+ResizableSignalTree::ResizableSignalTree(const size_t capacity)
+    : tree_(std::make_unique<SignalTree>(capacity)), current_(tree_.get()),
+      shards_(new Shard[kShards]), retired_(capacity, Retired::kNone) {}
+
+const int ResizableSignalTree::Acquire() {
+  Guard guard(*this);
+  return guard.Tree().Acquire();
+}
+
+void ResizableSignalTree::Release(const int index) {
+  if (index < 0) {
+    throw std::runtime_error("Release() called with invalid index!");
+  }
+  Guard guard(*this);
+  if (static_cast<size_t>(index) < guard.Tree().Capacity()) {
+    guard.Tree().Release(index);
+  } else {
+    ReleaseSlow(index);
+  }
+}
+
+void ResizableSignalTree::ReleaseSlow(const int index) {
+  const size_t leaf = static_cast<size_t>(index);
+  std::lock_guard<std::mutex> lock(retired_mutex_);
+  // Trees are published under retired_mutex_, so this is the newest one. The
+  // caller's guard keeps it alive.
+  SignalTree *tree = current_.load(std::memory_order_seq_cst);
+  if (leaf < tree->Capacity()) {
+    // The tree grew back over the leaf since the caller looked.
+    tree->Release(index);
+    return;
+  }
+  if (leaf < retired_.size() && retired_[leaf] == Retired::kHeld) {
+    retired_[leaf] = Retired::kNone;
+    --retired_held_;
+    return;
+  }
+  if (leaf < draining_capacity_ && retired_[leaf] == Retired::kNone) {
+    // Resize() has not looked at this leaf yet; it must not count it as
+    // held.
+    retired_[leaf] = Retired::kReleasedEarly;
+    return;
+  }
+  throw std::runtime_error("Release() called with invalid index!");
+}
+
+void ResizableSignalTree::Resize(const size_t capacity) {
+  if (capacity == 0) {
+    throw std::runtime_error("ResizableSignalTree capacity must be positive!");
+  }
+  std::lock_guard<std::mutex> resize_lock(resize_mutex_);
+  SignalTree *old = tree_.get();
+  const size_t old_capacity = old->Capacity();
+  if (capacity == old_capacity) {
+    return;
+  }
+
+  // Every leaf of the new tree starts acquired. Only leaves that did not
+  // exist in the old tree are freed before publishing; the old tree's free
+  // leaves are moved over once nobody uses it.
+  auto fresh = std::make_unique<SignalTree>(capacity);
+  {
+    std::vector<int> all(capacity);
+    fresh->AcquireN(capacity, all);
+  }
+  {
+    std::lock_guard<std::mutex> lock(retired_mutex_);
+    if (retired_.size() < capacity) {
+      retired_.resize(capacity, Retired::kNone);
+    }
+    std::vector<int> added;
+    for (size_t leaf = old_capacity; leaf < capacity; ++leaf) {
+      if (retired_[leaf] == Retired::kHeld) {
+        // Still held from an earlier shrink: it stays acquired and its
+        // holder releases it into the new tree.
+        retired_[leaf] = Retired::kNone;
+        --retired_held_;
+      } else {
+        added.push_back(static_cast<int>(leaf));
+      }
+    }
+    fresh->ReleaseMany(added);
+    draining_capacity_ = old_capacity;
+    current_.store(fresh.get(), std::memory_order_seq_cst);
+  }
+
+  WaitForReaders();
+
+  // The old tree is private now: its free leaves are exactly the leaves
+  // nobody holds.
+  std::vector<int> drained(static_cast<size_t>(old->FreeCount()));
+  old->AcquireN(drained.size(), drained);
+  {
+    std::lock_guard<std::mutex> lock(retired_mutex_);
+    std::vector<int> moved;
+    std::vector<bool> free(old_capacity, false);
+    for (const int leaf : drained) {
+      if (static_cast<size_t>(leaf) < capacity) {
+        moved.push_back(leaf);
+      } else {
+        free[leaf] = true;
+      }
+    }
+    fresh->ReleaseMany(moved);
+
+    for (size_t leaf = capacity; leaf < old_capacity; ++leaf) {
+      if (free[leaf] || retired_[leaf] == Retired::kReleasedEarly) {
+        retired_[leaf] = Retired::kNone;
+      } else {
+        retired_[leaf] = Retired::kHeld;
+        ++retired_held_;
+      }
+    }
+    draining_capacity_ = 0;
+  }
+  tree_ = std::move(fresh);
+}
+
+void ResizableSignalTree::WaitForReaders() {
+  // Two flips, as in userspace RCU: an operation that read the epoch before
+  // the first flip but registered late lands in the other parity, which the
+  // second flip drains. New operations always enter the parity that is not
+  // being waited for, so a busy tree cannot starve the resize.
+  for (int flip = 0; flip < 2; ++flip) {
+    const uint64_t epoch = epoch_.fetch_add(1, std::memory_order_seq_cst);
+    for (size_t i = 0; i < kShards; ++i) {
+      while (shards_[i].active[epoch & 1].load(std::memory_order_seq_cst) !=
+             0) {
+        std::this_thread::yield();
+      }
+    }
+  }
+}
+
+const int ResizableSignalTree::FreeCount() const {
+  Guard guard(*this);
+  return guard.Tree().FreeCount();
+}
+
+const size_t ResizableSignalTree::Capacity() const {
+  Guard guard(*this);
+  return guard.Tree().Capacity();
+}
+
+const size_t ResizableSignalTree::RetiredHeld() const {
+  std::lock_guard<std::mutex> lock(retired_mutex_);
+  return retired_held_;
+}
+
+} // namespace signal_tree
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "signal_tree/signal_tree.h"
+
+namespace signal_tree {
+
+// SignalTree whose capacity can change while other threads acquire and
+// release leaves. Leaf indices are stable across resizes.
+//
+// Acquire() and Release() run on the current SignalTree behind a sharded
+// epoch guard: they only bump a counter on their own cache line around the
+// call. Resize() builds a tree of the new capacity in which every leaf starts
+// acquired, frees the leaves that did not exist before, publishes it, waits
+// for the operations still on the old tree, and then moves the old tree's
+// free leaves over. Leaves that were held during the swap stay acquired in
+// the new tree and are released into it by their holders.
+//
+// Shrinking retires the leaves past the new capacity: free ones disappear at
+// once, held ones once their holder releases them (RetiredHeld() counts
+// those). Growing again before that simply hands them back to their holders.
+class ResizableSignalTree {
+public:
+  explicit ResizableSignalTree(const size_t capacity);
+
+  ~ResizableSignalTree() = default;
+
+  // Acquire a free leaf (if any). Returns -1 if none is free. A resize in
+  // progress can make this fail for as long as the old tree is drained.
+  const int Acquire();
+
+  // Release a leaf back to free state, or retire it if the tree has shrunk
+  // below it since it was acquired.
+  void Release(const int index);
+
+  // Changes the capacity to `capacity` (> 0). Resizes are serialized; they
+  // never block Acquire() or Release().
+  void Resize(const size_t capacity);
+
+  // Returns the number of free leaves in the tree.
+  const int FreeCount() const;
+
+  // Current number of leaves.
+  const size_t Capacity() const;
+
+  // Leaves past the capacity that are still held and will be retired when
+  // released.
+  const size_t RetiredHeld() const;
+
+  // Non-copyable, non-assignable
+  ResizableSignalTree(const ResizableSignalTree &) = delete;
+  ResizableSignalTree &operator=(const ResizableSignalTree &) = delete;
+
+private:
+  static constexpr size_t kShards = 64;
+
+  // Operations in flight that started in an even or odd epoch.
+  struct alignas(64) Shard {
+    std::atomic<uint64_t> active[2]{};
+  };
+
+  // Keeps the tree it read alive until destroyed.
+  class Guard {
+  public:
+    explicit Guard(const ResizableSignalTree &owner);
+    ~Guard();
+
+    SignalTree &Tree() const { return *tree_; }
+
+    Guard(const Guard &) = delete;
+    Guard &operator=(const Guard &) = delete;
+
+  private:
+    std::atomic<uint64_t> &active_;
+    SignalTree *tree_;
+  };
+
+  // Per-leaf bookkeeping of leaves past the capacity, under retired_mutex_.
+  enum class Retired : uint8_t {
+    kNone,
+    // Held past a shrink; retired on release.
+    kHeld,
+    // Released while the shrink that retires it was still draining.
+    kReleasedEarly,
+  };
+
+  // Waits until no operation that may still use a tree published before the
+  // current one is left.
+  void WaitForReaders();
+
+  // Release() of a leaf past the capacity of the tree it saw.
+  void ReleaseSlow(const int index);
+
+  std::unique_ptr<SignalTree> tree_;
+  std::atomic<SignalTree *> current_;
+  std::atomic<uint64_t> epoch_{0};
+  std::unique_ptr<Shard[]> shards_;
+
+  std::mutex resize_mutex_;
+
+  mutable std::mutex retired_mutex_;
+  std::vector<Retired> retired_;
+  size_t retired_held_{0};
+  // Capacity of the tree being drained by Resize(), 0 if none.
+  size_t draining_capacity_{0};
+};
+
+} // namespace signal_tree
@@ -1,106 +1,239 @@
+#include <algorithm>
 #include <atomic>
-#include <cassert>
+#include <bit>
 #include <cmath>
 #include <iostream>
 #include <memory>
+#include <stdexcept>
 #include <vector>
 
+#include "metrics/metrics.h"
 #include "signal_tree/signal_tree.h"
 
-#define PRINT_TREE(msg, tree, capacity)                                        \
+#define PRINT_TREE(msg)                                                        \
   do {                                                                         \
     std::cout << msg << ": ";                                                  \
-    for (size_t i = 1; i < 2 * capacity; ++i) {                                \
-      std::cout << tree.at(i).load() << " ";                                   \
+    for (size_t i = 1; i < 2 * leaves_; ++i) {                                 \
+      std::cout << At(i).load() << " ";                                        \
     }                                                                          \
     std::cout << "\n";                                                         \
   } while (0)
 
 namespace signal_tree {
 
-SignalTree::SignalTree(const size_t capacity) : capacity_(capacity) {
-  assert(capacity > 0 && ((capacity & (capacity - 1)) == 0));
+SignalTree::SignalTree(const size_t capacity, const Layout layout)
+    : capacity_(capacity), leaves_(std::bit_ceil(capacity)), layout_(layout) {
+  if (capacity == 0) {
+    throw std::runtime_error("SignalTree capacity must be positive!");
+  }
 
-  tree_.resize(2 * capacity);
+  const size_t num_nodes = 2 * leaves_;
+  if (layout == Layout::kPadded) {
+    padded_nodes_ = std::min(num_nodes, kMaxPaddedNodes);
+    padded_.reset(new PaddedCounter[padded_nodes_]);
+  }
+  // The compact array also spans the padded prefix so that At() needs no
+  // offset arithmetic; those counters are simply never touched.
+  compact_.reset(
+      new CounterLine[(num_nodes + kCountersPerLine - 1) / kCountersPerLine]);
 
-  // Initialize all leaves to 1 (meaning "free").
-  for (size_t i = 0; i < 2 * capacity; ++i) {
-    tree_.at(i).store(1);
+  // Initialize all leaves to 1 (meaning "free"). Padding leaves past the
+  // capacity stay 0: they look acquired forever, so no descent ever ends on
+  // one.
+  for (size_t i = leaves_; i < leaves_ + capacity; ++i) {
+    At(i).store(1, std::memory_order_relaxed);
   }
 
   // Build sums in the internal nodes by summing children.
-  for (size_t i = capacity - 1; i > 0; --i) {
-    int left = tree_.at(2 * i).load(std::memory_order_relaxed);
-    int right = tree_.at(2 * i + 1).load(std::memory_order_relaxed);
-    tree_.at(i).store(left + right, std::memory_order_relaxed);
+  for (size_t i = leaves_ - 1; i > 0; --i) {
+    int left = At(2 * i).load(std::memory_order_relaxed);
+    int right = At(2 * i + 1).load(std::memory_order_relaxed);
+    At(i).store(left + right, std::memory_order_relaxed);
   }
+  std::atomic_thread_fence(std::memory_order_release);
 }
 
-const int SignalTree::Acquire() {
-  // Decrement the root’s sum to see if a free slot is available. If the old
-  // root value was < 0, there is no free leaf.
-  if (tree_.at(1).fetch_sub(1, std::memory_order_seq_cst) <= 0) {
-    // We decremented below zero; revert it and fail.
-    tree_.at(1).fetch_add(1, std::memory_order_seq_cst);
-    return -1;
+const int SignalTree::Acquire() { return AcquireNear(0); }
+
+const int SignalTree::AcquireNear(const int leaf) {
+  if (leaf < 0 || static_cast<size_t>(leaf) >= capacity_) {
+    throw std::runtime_error("AcquireNear() called with invalid index!");
   }
 
-  std::vector<size_t> path;
-  path.push_back(1);
+  // Reserve one unit at the root. A CAS instead of fetch_sub/fetch_add keeps
+  // the root from going transiently negative, which would make concurrent
+  // acquirers fail while a leaf is free.
+  int free = At(1).load(std::memory_order_seq_cst);
+  while (true) {
+    if (free <= 0) {
+      LFWP_METRIC_COUNT("signal_tree.acquire.empty", 1);
+      return -1;
+    }
+    if (At(1).compare_exchange_weak(free, free - 1,
+                                    std::memory_order_seq_cst)) {
+      break;
+    }
+    LFWP_METRIC_COUNT("signal_tree.acquire.root_retries", 1);
+  }
 
+  // Release() increments bottom-up and acquirers decrement top-down, so a
+  // unit reserved on a node is always present in one of its children: the
+  // descent below never fails and never rolls back. A child is only retried
+  // when a concurrent acquirer took its last unit first, so the retries at
+  // each level are bounded by the acquirers passing through that node.
   size_t idx = 1;
 
-  while (idx < capacity_) {
-    size_t leftIdx = 2 * idx;
-    size_t rightIdx = 2 * idx + 1;
+  // Levels between the children of idx and the leaves.
+  size_t shift = static_cast<size_t>(std::countr_zero(leaves_));
+  const size_t target = leaves_ + static_cast<size_t>(leaf);
+
+  while (idx < leaves_) {
+    --shift;
+    // Prefer the child on the path to the target leaf. Once the descent has
+    // left that path, prefer the child that lies towards the target.
+    const size_t targetAncestor = target >> (shift + 1);
+    size_t firstIdx;
+    if (idx == targetAncestor) {
+      firstIdx = target >> shift;
+    } else {
+      firstIdx = idx > targetAncestor ? 2 * idx : 2 * idx + 1;
+    }
 
-    if (leftIdx >= capacity_) {
-      int expected = 1;
-      if (tree_[leftIdx].compare_exchange_strong(expected, 0,
-                                                 std::memory_order_seq_cst)) {
-        idx = leftIdx;
+    while (true) {
+      if (TakeUpTo(firstIdx, 1) == 1) {
+        idx = firstIdx;
         break;
       }
-    }
-    if (rightIdx >= capacity_) {
-      int expected = 1;
-      if (!tree_[rightIdx].compare_exchange_strong(expected, 0,
-                                                   std::memory_order_seq_cst)) {
-        // revert all internal nodes on path
-        for (size_t node : path) {
-          tree_[node].fetch_add(1);
-        }
-        // TODO: make this impossible.
-        return -1;
+      if (TakeUpTo(firstIdx ^ 1, 1) == 1) {
+        LFWP_METRIC_COUNT("signal_tree.acquire.detours", 1);
+        idx = firstIdx ^ 1;
+        break;
       }
-      idx = rightIdx;
-      break;
+      LFWP_METRIC_COUNT("signal_tree.acquire.descent_retries", 1);
+    }
+  }
+
+  return static_cast<int>(idx - leaves_);
+}
+
+int SignalTree::TakeUpTo(const size_t i, const int max) {
+  int value = At(i).load(std::memory_order_relaxed);
+  while (value > 0) {
+    const int take = std::min(value, max);
+    if (At(i).compare_exchange_weak(value, value - take,
+                                    std::memory_order_seq_cst)) {
+      return take;
     }
+  }
+  return 0;
+}
 
-    // Left node:
-    if (tree_.at(leftIdx).fetch_sub(1, std::memory_order_seq_cst) <= 0) {
-      tree_.at(leftIdx).fetch_add(1, std::memory_order_seq_cst);
-
-      // Right node:
-      if (tree_.at(rightIdx).fetch_sub(1, std::memory_order_seq_cst) <= 0) {
-        tree_.at(rightIdx).fetch_add(1, std::memory_order_seq_cst);
-        // Both children are out of capacity; revert entire path
-        for (auto node : path) {
-          tree_[node].fetch_add(1, std::memory_order_release);
-        }
-        // TODO: make this impossible.
-        return -1;
+void SignalTree::Distribute(const size_t node, int count, int *&out) {
+  // Release() increments bottom-up and acquirers decrement top-down, so the
+  // units reserved on `node` are always present in its children. Coming back
+  // around only happens when another acquirer took a unit first.
+  while (count > 0) {
+    for (const size_t child : {2 * node, 2 * node + 1}) {
+      const int taken = TakeUpTo(child, count);
+      if (taken == 0) {
+        continue;
+      }
+      if (child >= leaves_) {
+        *out++ = static_cast<int>(child - leaves_);
       } else {
-        idx = rightIdx;
-        path.push_back(rightIdx);
+        Distribute(child, taken, out);
+      }
+      count -= taken;
+      if (count == 0) {
+        break;
       }
+    }
+  }
+}
+
+const bool SignalTree::AcquireN(const size_t k, std::span<int> out) {
+  if (out.size() < k) {
+    throw std::runtime_error("AcquireN() called with a too small output!");
+  }
+  if (k == 0) {
+    return true;
+  }
+
+  // Reserve all k units at the root in one step.
+  const int count = static_cast<int>(k);
+  int free = At(1).load(std::memory_order_seq_cst);
+  do {
+    if (free < count) {
+      return false;
+    }
+  } while (!At(1).compare_exchange_weak(free, free - count,
+                                        std::memory_order_seq_cst));
+
+  if (leaves_ == 1) {
+    out[0] = 0;
+    return true;
+  }
+  int *cursor = out.data();
+  Distribute(1, count, cursor);
+  return true;
+}
+
+void SignalTree::ReleaseMany(std::span<const int> indices) {
+  for (const int index : indices) {
+    if (index < 0 || static_cast<size_t>(index) >= capacity_) {
+      throw std::runtime_error("ReleaseMany() called with invalid index!");
+    }
+  }
+
+  // Mark leaves as free: 0 -> 1, and collect (parent, increment) pairs.
+  std::vector<std::pair<size_t, int>> level;
+  level.reserve(indices.size());
+  bool double_release = false;
+  for (const int index : indices) {
+    const size_t leafIndex = leaves_ + static_cast<size_t>(index);
+    int expected = 0;
+    if (At(leafIndex).compare_exchange_strong(expected, 1,
+                                              std::memory_order_seq_cst)) {
+      level.emplace_back(leafIndex / 2, 1);
     } else {
-      idx = leftIdx;
-      path.push_back(leftIdx);
+      double_release = true;
+    }
+  }
+  std::sort(level.begin(), level.end());
+
+  // All leaves sit on the same level, so walking up one level at a time and
+  // merging equal parents touches every shared ancestor exactly once, and
+  // still increments children before their parents.
+  // With a single leaf, the leaf is the root.
+  bool became_free = leaves_ == 1 && !level.empty();
+  while (!level.empty() && level.front().first != 0) {
+    size_t merged = 0;
+    for (size_t i = 0; i < level.size(); ++i) {
+      if (merged > 0 && level[merged - 1].first == level[i].first) {
+        level[merged - 1].second += level[i].second;
+      } else {
+        level[merged++] = level[i];
+      }
+    }
+    level.resize(merged);
+
+    for (auto &[node, delta] : level) {
+      if (node == 1) {
+        became_free = At(1).fetch_add(delta, std::memory_order_seq_cst) == 0;
+      } else {
+        At(node).fetch_add(delta, std::memory_order_acq_rel);
+      }
+      node /= 2;
     }
   }
 
-  return static_cast<int>(idx - capacity_);
+  if (became_free && waiters_.load(std::memory_order_seq_cst) > 0) {
+    WakeWaiters();
+  }
+
+  if (double_release) {
+    throw std::runtime_error("Releasing a leaf that was 0, CAS failed!");
+  }
 }
 
 void SignalTree::Release(const int &index) {
@@ -109,19 +242,108 @@ void SignalTree::Release(const int &index) {
   }
 
   // Mark leaf as free: 0 -> 1
-  size_t leafIndex = capacity_ + static_cast<size_t>(index);
+  size_t leafIndex = leaves_ + static_cast<size_t>(index);
   int expected = 0;
-  if (!tree_.at(leafIndex).compare_exchange_strong(expected, 1,
-                                                   std::memory_order_seq_cst)) {
+  if (!At(leafIndex).compare_exchange_strong(expected, 1,
+                                             std::memory_order_seq_cst)) {
     throw std::runtime_error("Releasing a leaf that was 0, CAS failed!");
   }
 
   // Propagate +1 up the tree to the root.
   size_t parent = leafIndex / 2;
-  while (parent >= 1) {
-    tree_.at(parent).fetch_add(1, std::memory_order_acq_rel);
+  while (parent > 1) {
+    At(parent).fetch_add(1, std::memory_order_acq_rel);
     parent /= 2;
   }
+
+  // Only the release that makes the tree non-empty pays for a wakeup. The
+  // seq_cst pair (root, waiters_) here and in AcquireWaiting() guarantees
+  // that either the waiter sees the free leaf or we see the waiter. With a
+  // single leaf, the leaf is the root and has already been updated.
+  const bool became_free =
+      parent == 0 || At(1).fetch_add(1, std::memory_order_seq_cst) == 0;
+  if (became_free && waiters_.load(std::memory_order_seq_cst) > 0) {
+    WakeWaiters();
+  }
+}
+
+const int SignalTree::AcquireBlocking() {
+  return AcquireWaiting(std::nullopt);
+}
+
+const int SignalTree::AcquireWaiting(
+    const std::optional<std::chrono::steady_clock::time_point> deadline) {
+  int leaf = Acquire();
+  if (leaf >= 0) {
+    return leaf;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(wait_mutex_);
+    waiters_.fetch_add(1, std::memory_order_seq_cst);
+    ++blocked_;
+    while ((leaf = Acquire()) < 0) {
+      if (!deadline) {
+        wait_cv_.wait(lock);
+      } else if (wait_cv_.wait_until(lock, *deadline) ==
+                 std::cv_status::timeout) {
+        leaf = Acquire();
+        break;
+      }
+    }
+    --blocked_;
+    waiters_.fetch_sub(1, std::memory_order_seq_cst);
+  }
+
+  // Releases that raced with our wakeup did not wake anyone themselves.
+  if (leaf >= 0 && IsFree() && waiters_.load(std::memory_order_seq_cst) > 0) {
+    WakeWaiters();
+  }
+  return leaf;
+}
+
+void SignalTree::AcquireAsync(std::function<void(int)> callback) {
+  int leaf = Acquire();
+  if (leaf < 0) {
+    std::unique_lock<std::mutex> lock(wait_mutex_);
+    async_waiters_.push_back(std::move(callback));
+    waiters_.fetch_add(1, std::memory_order_seq_cst);
+
+    // A leaf released before we registered may not have woken anyone.
+    leaf = Acquire();
+    if (leaf < 0) {
+      return;
+    }
+    callback = std::move(async_waiters_.front());
+    async_waiters_.pop_front();
+    waiters_.fetch_sub(1, std::memory_order_seq_cst);
+  }
+  callback(leaf);
+}
+
+void SignalTree::WakeWaiters() {
+  std::unique_lock<std::mutex> lock(wait_mutex_);
+
+  // Async callbacks are served first, on this thread, in FIFO order.
+  while (!async_waiters_.empty()) {
+    const int leaf = Acquire();
+    if (leaf < 0) {
+      return;
+    }
+    auto callback = std::move(async_waiters_.front());
+    async_waiters_.pop_front();
+    waiters_.fetch_sub(1, std::memory_order_seq_cst);
+
+    lock.unlock();
+    callback(leaf);
+    lock.lock();
+  }
+
+  // Wake a single blocked acquirer; if it sees more free leaves after taking
+  // one, it wakes the next.
+  if (blocked_ > 0) {
+    wait_cv_.notify_one();
+  }
 }
 
 } // namespace signal_tree
\ No newline at end of file
@@ -1,48 +1,169 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <deque>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
 
 namespace signal_tree {
 
 class SignalTree {
 public:
-  explicit SignalTree(const size_t capacity);
+  // Memory layout of the node counters.
+  enum class Layout {
+    // Contiguous Eytzinger (BFS) order: node i has children 2*i and 2*i + 1,
+    // 16 counters per cache line. Smallest footprint.
+    kEytzinger,
+    // Eytzinger order, but the top kMaxPaddedNodes nodes each get their own
+    // cache line, so threads working on different subtrees do not ping-pong
+    // the lines of the hot upper levels.
+    kPadded,
+  };
+
+  // Number of nodes (from the root down) that kPadded places on their own
+  // cache line: the top 10 levels, 64KB.
+  static constexpr size_t kMaxPaddedNodes = 1024;
+
+  // Any positive capacity works: the leaf level is padded up to the next
+  // power of two with leaves that start (and stay) acquired. Throws if
+  // `capacity` is 0.
+  explicit SignalTree(const size_t capacity,
+                      const Layout layout = Layout::kPadded);
 
   ~SignalTree() = default;
 
-  // Acquire a free leaf (if any). Returns -1 if none is free.
+  // Acquire a free leaf (if any). Returns -1 if none is free; once the root
+  // shows a free leaf, the call always ends with a leaf.
   const int Acquire();
 
+  // Acquire the free leaf closest to `leaf` (if any). The descent follows the
+  // path to `leaf` and only leaves it where that subtree has nothing free,
+  // so the search covers the smallest subtree containing `leaf` first.
+  // Threads that pass their previous (or a per-thread home) leaf mostly stay
+  // on disjoint subtrees. Acquire() is AcquireNear(0). Returns -1 if no leaf
+  // is free.
+  const int AcquireNear(const int leaf);
+
   // Release a leaf back to free state.
   void Release(const int &index);
 
+  // Acquire a free leaf, parking the calling thread until one is released
+  // if none is free.
+  const int AcquireBlocking();
+
+  // Like AcquireBlocking(), but gives up and returns -1 once `timeout` has
+  // passed without a free leaf.
+  template <class Rep, class Period>
+  const int AcquireFor(const std::chrono::duration<Rep, Period> &timeout) {
+    return AcquireWaiting(std::chrono::steady_clock::now() + timeout);
+  }
+
+  // Invoke `callback` with an acquired leaf as soon as one is free: inline if
+  // one is free now, otherwise on the thread whose Release() frees it. The
+  // callback owns the leaf and must release it. Callbacks still pending when
+  // the tree is destroyed are dropped.
+  void AcquireAsync(std::function<void(int)> callback);
+
+  // Acquire k free leaves at once and write them to out[0..k). Either all k
+  // leaves are acquired, or none are and false is returned. The k units are
+  // reserved at the root with a single atomic and split down the subtrees,
+  // so root contention scales with the number of batches, not leaves.
+  const bool AcquireN(const size_t k, std::span<int> out);
+
+  // Release several leaves at once. Ancestor increments are merged, so every
+  // shared ancestor (the root included) is updated once per batch. Throws
+  // without touching the tree if an index is out of range; throws after
+  // releasing the other leaves if one of them was already free.
+  void ReleaseMany(std::span<const int> indices);
+
   // True if there is at least one free leaf in the tree.
   const bool IsFree() const {
-    return tree_[1].load(std::memory_order_acquire) > 0;
+    return At(1).load(std::memory_order_acquire) > 0;
   }
 
   // Returns the number of free leaves in the tree.
   const int FreeCount() const {
-    return tree_[1].load(std::memory_order_acquire);
+    return At(1).load(std::memory_order_acquire);
   }
 
   // Number of leaves (capacity).
   const size_t Capacity() const { return capacity_; }
 
+  // Layout of the node counters.
+  const Layout GetLayout() const { return layout_; }
+
   // Non-copyable, non-assignable
   SignalTree(const SignalTree &) = delete;
   SignalTree &operator=(const SignalTree &) = delete;
 
 private:
+  static constexpr size_t kCacheLine = 64;
+  static constexpr size_t kCountersPerLine =
+      kCacheLine / sizeof(std::atomic<int>);
+
+  struct alignas(kCacheLine) PaddedCounter {
+    std::atomic<int> value{0};
+  };
+
+  struct alignas(kCacheLine) CounterLine {
+    std::atomic<int> value[kCountersPerLine]{};
+  };
+
+  // Parks until a leaf is acquired or `deadline` (if any) passes.
+  const int AcquireWaiting(
+      const std::optional<std::chrono::steady_clock::time_point> deadline);
+
+  // Hands freed leaves to pending AcquireAsync() callbacks and wakes one
+  // blocked acquirer. Called by the release that moves the root from 0 to 1
+  // and by woken acquirers that still see free leaves (passing the wakeup on).
+  void WakeWaiters();
+
+  // Moves up to `max` units from node i to the caller and returns how many
+  // were taken.
+  int TakeUpTo(const size_t i, const int max);
+
+  // Claims `count` units that have already been reserved on `node` from its
+  // subtree, writing the acquired leaves to `out`.
+  void Distribute(const size_t node, int count, int *&out);
+
+  // Counter of node i (unchecked).
+  std::atomic<int> &At(const size_t i) {
+    return i < padded_nodes_ ? padded_[i].value
+                             : compact_[i / kCountersPerLine]
+                                   .value[i % kCountersPerLine];
+  }
+  const std::atomic<int> &At(const size_t i) const {
+    return const_cast<SignalTree *>(this)->At(i);
+  }
+
   const size_t capacity_{0};
+  // Leaf level width: capacity_ rounded up to a power of two.
+  const size_t leaves_{0};
+  const Layout layout_;
 
-  // We store 2*kCapacity nodes in a segment-tree layout:
-  //    - Internal nodes [1..kCapacity-1] store sums of children.
-  //    - Leaves [kCapacity..2*kCapacity-1] store 1 (free) or 0 (acquired).
+  // We store 2*leaves_ nodes in a segment-tree layout:
+  //    - Internal nodes [1..leaves_-1] store sums of children.
+  //    - Leaves [leaves_..2*leaves_-1] store 1 (free) or 0 (acquired). The
+  //      padding leaves past capacity_ are always 0.
   // Index 0 is unused, so that node i has children (2*i) and (2*i + 1).
-  std::deque<std::atomic<int>> tree_;
+  // Nodes below padded_nodes_ live in padded_, the rest in compact_.
+  size_t padded_nodes_{0};
+  std::unique_ptr<PaddedCounter[]> padded_;
+  std::unique_ptr<CounterLine[]> compact_;
+
+  // Parked acquirers plus pending async callbacks. Releases only take
+  // wait_mutex_ when they move the root from 0 to 1 and this is non-zero, so
+  // trees nobody waits on never touch the mutex.
+  std::atomic<int> waiters_{0};
+  std::mutex wait_mutex_;
+  std::condition_variable wait_cv_;
+  int blocked_{0};
+  std::deque<std::function<void(int)>> async_waiters_;
 };
 
 } // namespace signal_tree
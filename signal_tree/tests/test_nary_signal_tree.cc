@@ -0,0 +1,105 @@
+#include <atomic>
+#include <gtest/gtest.h>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "signal_tree/nary_signal_tree.h"
+
+TEST(NarySignalTreeTest, BasicInitializationTest) {
+  signal_tree::NarySignalTree st(8);
+  EXPECT_EQ(st.Capacity(), 8);
+  EXPECT_EQ(st.FreeCount(), 8);
+  EXPECT_TRUE(st.IsFree());
+  EXPECT_EQ(st.Depth(), 1);
+}
+
+TEST(NarySignalTreeTest, DepthForLargeCapacity) {
+  // 64 leaves per word, 16 words per node: 1K leaves per bottom node, and
+  // each extra level multiplies that by 16.
+  EXPECT_EQ(signal_tree::NarySignalTree(1024).Depth(), 1);
+  EXPECT_EQ(signal_tree::NarySignalTree(16384).Depth(), 2);
+  EXPECT_EQ(signal_tree::NarySignalTree(65536).Depth(), 3);
+}
+
+TEST(NarySignalTreeTest, AcquireAllLeavesNonPowerOfTwo) {
+  const int kLeaves = 1000;
+  signal_tree::NarySignalTree st(kLeaves);
+
+  std::set<int> seen;
+  for (int i = 0; i < kLeaves; ++i) {
+    int leaf = st.Acquire();
+    ASSERT_GE(leaf, 0);
+    ASSERT_LT(leaf, kLeaves);
+    EXPECT_TRUE(seen.insert(leaf).second) << "Leaf " << leaf << " acquired twice";
+  }
+  EXPECT_FALSE(st.IsFree());
+  EXPECT_EQ(st.Acquire(), -1);
+
+  st.Release(777);
+  EXPECT_EQ(st.FreeCount(), 1);
+  EXPECT_EQ(st.Acquire(), 777);
+}
+
+TEST(NarySignalTreeTest, DoubleReleaseShouldFail) {
+  signal_tree::NarySignalTree st(2);
+
+  int leaf = st.Acquire();
+  EXPECT_GE(leaf, 0);
+
+  st.Release(leaf);
+  EXPECT_THROW(st.Release(leaf), std::runtime_error);
+  EXPECT_EQ(st.FreeCount(), 2);
+}
+
+TEST(NarySignalTreeTest, ReleaseInvalidIndexShouldThrow) {
+  signal_tree::NarySignalTree st(4);
+
+  EXPECT_THROW(st.Release(-1), std::runtime_error);
+  EXPECT_THROW(st.Release(4), std::runtime_error);
+}
+
+/**
+ * Many threads acquire/release concurrently across a multi-level tree; no leaf
+ * may be owned twice and the tree must end up fully free.
+ */
+TEST(NarySignalTreeTest, MultiThreadOwnershipCheck) {
+  const int kLeaves = 20000;
+  const int kThreads = 8;
+  const int kIterations = 20000;
+
+  signal_tree::NarySignalTree st(kLeaves);
+  std::vector<std::atomic<bool>> ownership(kLeaves);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&]() {
+      std::vector<int> held;
+      for (int i = 0; i < kIterations; ++i) {
+        // Hold a few leaves at a time so acquires and releases interleave.
+        if (held.size() < 4) {
+          int leaf = st.Acquire();
+          ASSERT_NE(leaf, -1);
+          EXPECT_FALSE(ownership[leaf].exchange(true));
+          held.push_back(leaf);
+        } else {
+          for (int leaf : held) {
+            ownership[leaf].store(false);
+            st.Release(leaf);
+          }
+          held.clear();
+        }
+      }
+      for (int leaf : held) {
+        ownership[leaf].store(false);
+        st.Release(leaf);
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  EXPECT_EQ(st.FreeCount(), kLeaves);
+}
@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <atomic>
+#include <gtest/gtest.h>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "signal_tree/resizable_signal_tree.h"
+
+TEST(ResizableSignalTreeTest, GrowKeepsHeldLeaves) {
+  signal_tree::ResizableSignalTree st(3);
+  const int a = st.Acquire();
+  const int b = st.Acquire();
+  ASSERT_GE(a, 0);
+  ASSERT_GE(b, 0);
+
+  st.Resize(10);
+  EXPECT_EQ(st.Capacity(), 10);
+  EXPECT_EQ(st.FreeCount(), 8);
+
+  std::vector<int> leaves;
+  int leaf;
+  while ((leaf = st.Acquire()) >= 0) {
+    leaves.push_back(leaf);
+  }
+  EXPECT_EQ(leaves.size(), 8);
+  EXPECT_EQ(std::count(leaves.begin(), leaves.end(), a), 0);
+  EXPECT_EQ(std::count(leaves.begin(), leaves.end(), b), 0);
+
+  // Leaves acquired before the resize are released into the new tree.
+  st.Release(a);
+  st.Release(b);
+  EXPECT_EQ(st.FreeCount(), 2);
+  EXPECT_THROW(st.Release(a), std::runtime_error);
+}
+
+TEST(ResizableSignalTreeTest, ShrinkRetiresLeavesOnRelease) {
+  signal_tree::ResizableSignalTree st(8);
+  std::vector<int> held;
+  for (int i = 0; i < 8; ++i) {
+    held.push_back(st.Acquire());
+  }
+  std::sort(held.begin(), held.end());
+  // Free the low half; leaves 4..7 stay held.
+  for (int i = 0; i < 4; ++i) {
+    st.Release(held[i]);
+  }
+
+  st.Resize(2);
+  EXPECT_EQ(st.Capacity(), 2);
+  EXPECT_EQ(st.FreeCount(), 2);
+  EXPECT_EQ(st.RetiredHeld(), 4);
+
+  st.Release(7);
+  EXPECT_EQ(st.RetiredHeld(), 3);
+  EXPECT_EQ(st.FreeCount(), 2);
+  EXPECT_THROW(st.Release(7), std::runtime_error);
+  EXPECT_THROW(st.Release(3), std::runtime_error);
+
+  // Growing over a retired leaf that is still held gives it back to its
+  // holder.
+  st.Resize(6);
+  EXPECT_EQ(st.RetiredHeld(), 1);
+  // Leaves 2 and 3 were free before the shrink, so they are new leaves now.
+  EXPECT_EQ(st.FreeCount(), 4);
+  st.Release(4);
+  st.Release(5);
+  EXPECT_EQ(st.FreeCount(), 6);
+  st.Release(6);
+  EXPECT_EQ(st.RetiredHeld(), 0);
+  EXPECT_THROW(st.Resize(0), std::runtime_error);
+}
+
+/**
+ * Threads acquire and release while the capacity bounces up and down.
+ * Ownership flags catch leaves handed out twice, and once everything is
+ * released and the size settles every leaf must be free again.
+ */
+TEST(ResizableSignalTreeTest, MultiThreadResize) {
+  constexpr int kMaxCapacity = 64;
+  constexpr int kThreads = 4;
+  constexpr int kIterations = 20000;
+
+  signal_tree::ResizableSignalTree st(kMaxCapacity);
+  std::unique_ptr<std::atomic<bool>[]> owned(
+      new std::atomic<bool>[kMaxCapacity]);
+  for (int i = 0; i < kMaxCapacity; ++i) {
+    owned[i] = false;
+  }
+  std::atomic<int> errors{0};
+  std::atomic<bool> done{false};
+
+  std::thread resizer([&] {
+    size_t capacity = kMaxCapacity;
+    while (!done.load()) {
+      capacity = capacity == kMaxCapacity ? 7 : capacity * 3;
+      st.Resize(std::min<size_t>(capacity, kMaxCapacity));
+    }
+    st.Resize(kMaxCapacity);
+  });
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&] {
+      std::vector<int> held;
+      for (int i = 0; i < kIterations; ++i) {
+        if (held.size() < 4) {
+          const int leaf = st.Acquire();
+          if (leaf >= 0) {
+            if (leaf >= kMaxCapacity || owned[leaf].exchange(true)) {
+              errors.fetch_add(1);
+            } else {
+              held.push_back(leaf);
+            }
+          }
+        } else {
+          for (const int leaf : held) {
+            owned[leaf] = false;
+            st.Release(leaf);
+          }
+          held.clear();
+        }
+      }
+      for (const int leaf : held) {
+        owned[leaf] = false;
+        st.Release(leaf);
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  done = true;
+  resizer.join();
+
+  EXPECT_EQ(errors.load(), 0);
+  EXPECT_EQ(st.Capacity(), kMaxCapacity);
+  EXPECT_EQ(st.RetiredHeld(), 0);
+  EXPECT_EQ(st.FreeCount(), kMaxCapacity);
+}
@@ -31,6 +31,78 @@ TEST(SignalTreeTest, AcquireAllLeavesSingleThread) {
   EXPECT_EQ(st.Acquire(), -1);
 }
 
+TEST(SignalTreeTest, SingleLeaf) {
+  signal_tree::SignalTree st(1);
+  EXPECT_EQ(st.Acquire(), 0);
+  EXPECT_EQ(st.Acquire(), -1);
+  st.Release(0);
+  EXPECT_EQ(st.FreeCount(), 1);
+
+  std::vector<int> leaves(1);
+  EXPECT_TRUE(st.AcquireN(1, leaves));
+  EXPECT_EQ(leaves[0], 0);
+  EXPECT_EQ(st.FreeCount(), 0);
+  st.ReleaseMany(leaves);
+  EXPECT_EQ(st.FreeCount(), 1);
+}
+
+TEST(SignalTreeTest, LayoutsBehaveTheSame) {
+  // 4096 leaves: 8192 nodes, so kPadded stores both padded and compact nodes.
+  for (auto layout : {signal_tree::SignalTree::Layout::kEytzinger,
+                      signal_tree::SignalTree::Layout::kPadded}) {
+    signal_tree::SignalTree st(4096, layout);
+    EXPECT_EQ(st.GetLayout(), layout);
+    EXPECT_EQ(st.FreeCount(), 4096);
+
+    std::vector<bool> seen(4096, false);
+    for (int i = 0; i < 4096; ++i) {
+      int leaf = st.Acquire();
+      ASSERT_GE(leaf, 0);
+      ASSERT_LT(leaf, 4096);
+      EXPECT_FALSE(seen[leaf]);
+      seen[leaf] = true;
+    }
+    EXPECT_EQ(st.Acquire(), -1);
+
+    for (int i = 4095; i >= 0; --i) {
+      st.Release(i);
+    }
+    EXPECT_EQ(st.FreeCount(), 4096);
+  }
+}
+
+TEST(SignalTreeTest, NonPowerOfTwoCapacity) {
+  for (const int capacity : {3, 5, 6, 7, 100, 1025}) {
+    signal_tree::SignalTree st(capacity);
+    EXPECT_EQ(st.Capacity(), capacity);
+    EXPECT_EQ(st.FreeCount(), capacity);
+
+    // Padding leaves are never handed out, whichever way we ask.
+    std::vector<bool> seen(capacity, false);
+    for (int i = 0; i < capacity; ++i) {
+      const int leaf = i % 2 == 0 ? st.Acquire() : st.AcquireNear(capacity - 1);
+      ASSERT_GE(leaf, 0);
+      ASSERT_LT(leaf, capacity);
+      EXPECT_FALSE(seen[leaf]);
+      seen[leaf] = true;
+    }
+    EXPECT_EQ(st.Acquire(), -1);
+    EXPECT_THROW(st.Release(capacity), std::runtime_error);
+
+    std::vector<int> all(capacity);
+    for (int i = 0; i < capacity; ++i) {
+      all[i] = i;
+    }
+    st.ReleaseMany(all);
+    EXPECT_EQ(st.FreeCount(), capacity);
+    ASSERT_TRUE(st.AcquireN(capacity, all));
+    std::sort(all.begin(), all.end());
+    EXPECT_EQ(all.back(), capacity - 1);
+    EXPECT_FALSE(st.AcquireN(1, all));
+  }
+  EXPECT_THROW(signal_tree::SignalTree(0), std::runtime_error);
+}
+
 TEST(SignalTreeTest, AcquireAndReleaseSingleThread) {
   signal_tree::SignalTree st(4);
   EXPECT_EQ(st.Capacity(), 4);
@@ -103,6 +175,78 @@ TEST(SignalTreeTest, ReleaseInvalidIndexShouldThrow) {
   st.Release(leaf);
 }
 
+TEST(SignalTreeTest, AcquireNearPrefersClosestLeaves) {
+  signal_tree::SignalTree st(8);
+
+  // Leaves come out nearest-subtree first: the hint, its sibling, the rest
+  // of its 4-leaf subtree, then the other half starting from the side that
+  // faces the hint.
+  std::vector<int> order;
+  for (int i = 0; i < 8; ++i) {
+    order.push_back(st.AcquireNear(5));
+  }
+  EXPECT_EQ(order, (std::vector<int>{5, 4, 6, 7, 3, 2, 1, 0}));
+  EXPECT_EQ(st.AcquireNear(5), -1);
+
+  st.Release(2);
+  EXPECT_EQ(st.AcquireNear(7), 2);
+
+  EXPECT_THROW(st.AcquireNear(-1), std::runtime_error);
+  EXPECT_THROW(st.AcquireNear(8), std::runtime_error);
+}
+
+TEST(SignalTreeTest, AcquireNAndReleaseMany) {
+  signal_tree::SignalTree st(16);
+
+  std::vector<int> leaves(5);
+  EXPECT_TRUE(st.AcquireN(5, leaves));
+  EXPECT_EQ(st.FreeCount(), 11);
+  std::sort(leaves.begin(), leaves.end());
+  EXPECT_EQ(std::adjacent_find(leaves.begin(), leaves.end()), leaves.end());
+  for (int leaf : leaves) {
+    EXPECT_GE(leaf, 0);
+    EXPECT_LT(leaf, 16);
+  }
+
+  // All-or-nothing: 12 leaves are not available.
+  std::vector<int> too_many(12, -1);
+  EXPECT_FALSE(st.AcquireN(12, too_many));
+  EXPECT_EQ(st.FreeCount(), 11);
+
+  std::vector<int> rest(11);
+  EXPECT_TRUE(st.AcquireN(11, rest));
+  EXPECT_FALSE(st.IsFree());
+  EXPECT_EQ(st.Acquire(), -1);
+
+  st.ReleaseMany(leaves);
+  st.ReleaseMany(rest);
+  EXPECT_EQ(st.FreeCount(), 16);
+
+  // Every leaf is really free again.
+  std::vector<int> all(16);
+  EXPECT_TRUE(st.AcquireN(16, all));
+}
+
+TEST(SignalTreeTest, ReleaseManyErrors) {
+  signal_tree::SignalTree st(8);
+
+  std::vector<int> leaves(4);
+  ASSERT_TRUE(st.AcquireN(4, leaves));
+
+  // Invalid index: nothing is released.
+  std::vector<int> invalid = {leaves[0], 8};
+  EXPECT_THROW(st.ReleaseMany(invalid), std::runtime_error);
+  EXPECT_EQ(st.FreeCount(), 4);
+
+  // Duplicate index: the valid leaves are still released.
+  std::vector<int> duplicate = {leaves[0], leaves[1], leaves[0]};
+  EXPECT_THROW(st.ReleaseMany(duplicate), std::runtime_error);
+  EXPECT_EQ(st.FreeCount(), 6);
+
+  std::vector<int> small(1);
+  EXPECT_THROW(st.AcquireN(2, small), std::runtime_error);
+}
+
 //----------------------------------------------------------------------
 // Multi-threaded tests
 //----------------------------------------------------------------------
@@ -309,3 +453,219 @@ TEST(SignalTreeTest, MultiThreadOwnershipCheck) {
   EXPECT_GE(final_acquires, 0)
       << "Basic sanity check on total successful acquires.";
 }
+
+/**
+ * All threads acquire at the same time while exactly enough leaves are free.
+ * No acquire may fail: a successful root reservation must always end with a
+ * leaf.
+ */
+TEST(SignalTreeTest, MultiThreadAcquireNeverFailsSpuriously) {
+  const int kLeaves = 64;
+  const int kThreads = 8;
+  const int kPerThread = kLeaves / kThreads;
+  const int kRounds = 200;
+
+  signal_tree::SignalTree st(kLeaves);
+
+  for (int round = 0; round < kRounds; ++round) {
+    std::atomic<int> ready(0);
+    std::atomic<int> failures(0);
+    std::vector<std::vector<int>> held(kThreads);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+      threads.emplace_back([&, t]() {
+        ready.fetch_add(1);
+        while (ready.load() < kThreads) {
+          std::this_thread::yield();
+        }
+        for (int i = 0; i < kPerThread; ++i) {
+          const int leaf = st.AcquireNear((t * 7 + i) % kLeaves);
+          if (leaf == -1) {
+            failures.fetch_add(1);
+          } else {
+            held[t].push_back(leaf);
+          }
+        }
+      });
+    }
+    for (auto &t : threads) {
+      t.join();
+    }
+
+    ASSERT_EQ(failures.load(), 0) << "in round " << round;
+    EXPECT_FALSE(st.IsFree());
+    for (auto &leaves : held) {
+      st.ReleaseMany(leaves);
+    }
+    ASSERT_EQ(st.FreeCount(), kLeaves);
+  }
+}
+
+/**
+ * Each thread acquires near its own home leaf and then near the leaf it held
+ * last. Ownership flags catch any leaf handed out twice.
+ */
+TEST(SignalTreeTest, MultiThreadAcquireNearOwnershipCheck) {
+  const int kLeaves = 16;
+  const int kThreads = 8;
+  const int kIterations = 2000;
+
+  signal_tree::SignalTree st(kLeaves);
+  std::vector<std::atomic<bool>> ownership(kLeaves);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t]() {
+      int hint = t * kLeaves / kThreads;
+      for (int i = 0; i < kIterations; ++i) {
+        const int leaf = st.AcquireNear(hint);
+        if (leaf == -1) {
+          std::this_thread::yield();
+          continue;
+        }
+        EXPECT_FALSE(ownership[leaf].exchange(true))
+            << "Leaf " << leaf << " was already owned by another thread!";
+        ownership[leaf].store(false);
+        st.Release(leaf);
+        hint = leaf;
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  EXPECT_EQ(st.FreeCount(), kLeaves);
+}
+
+/**
+ * Threads acquire and release leaves in batches of different sizes. Ownership
+ * flags catch any leaf handed out twice, and the tree must end up full.
+ */
+TEST(SignalTreeTest, MultiThreadBatchOwnershipCheck) {
+  const int kLeaves = 64;
+  const int kThreads = 8;
+  const int kIterations = 2000;
+
+  signal_tree::SignalTree st(kLeaves);
+  std::vector<std::atomic<bool>> ownership(kLeaves);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t]() {
+      const size_t batch = 1 + t % 4;
+      std::vector<int> leaves(batch);
+      for (int i = 0; i < kIterations; ++i) {
+        if (!st.AcquireN(batch, leaves)) {
+          std::this_thread::yield();
+          continue;
+        }
+        for (int leaf : leaves) {
+          EXPECT_FALSE(ownership[leaf].exchange(true))
+              << "Leaf " << leaf << " was already owned by another thread!";
+        }
+        for (int leaf : leaves) {
+          ownership[leaf].store(false);
+        }
+        st.ReleaseMany(leaves);
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  EXPECT_EQ(st.FreeCount(), kLeaves);
+}
+
+TEST(SignalTreeTest, AcquireBlockingWakesOnRelease) {
+  signal_tree::SignalTree st(2);
+  const int leaf1 = st.Acquire();
+  const int leaf2 = st.Acquire();
+  ASSERT_FALSE(st.IsFree());
+
+  std::atomic<int> acquired(-1);
+  std::thread waiter([&]() { acquired.store(st.AcquireBlocking()); });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_EQ(acquired.load(), -1);
+
+  st.Release(leaf2);
+  waiter.join();
+  EXPECT_EQ(acquired.load(), leaf2);
+
+  st.Release(leaf1);
+  st.Release(leaf2);
+  EXPECT_EQ(st.FreeCount(), 2);
+}
+
+TEST(SignalTreeTest, AcquireForTimesOut) {
+  signal_tree::SignalTree st(1);
+  ASSERT_EQ(st.Acquire(), 0);
+
+  const auto start = std::chrono::steady_clock::now();
+  EXPECT_EQ(st.AcquireFor(std::chrono::milliseconds(20)), -1);
+  EXPECT_GE(std::chrono::steady_clock::now() - start,
+            std::chrono::milliseconds(20));
+
+  st.Release(0);
+  EXPECT_EQ(st.AcquireFor(std::chrono::milliseconds(20)), 0);
+}
+
+TEST(SignalTreeTest, AcquireAsyncRunsOnRelease) {
+  signal_tree::SignalTree st(2);
+
+  // Free leaf: the callback runs inline.
+  int inline_leaf = -1;
+  st.AcquireAsync([&](int leaf) { inline_leaf = leaf; });
+  EXPECT_GE(inline_leaf, 0);
+  const int other = st.Acquire();
+  ASSERT_GE(other, 0);
+
+  // Full tree: the callbacks run on the releasing threads, in order.
+  std::vector<int> served;
+  st.AcquireAsync([&](int leaf) { served.push_back(leaf); });
+  st.AcquireAsync([&](int leaf) { served.push_back(leaf + 100); });
+  EXPECT_TRUE(served.empty());
+
+  st.Release(other);
+  EXPECT_EQ(served, (std::vector<int>{other}));
+  st.Release(inline_leaf);
+  EXPECT_EQ(served, (std::vector<int>{other, inline_leaf + 100}));
+  EXPECT_EQ(st.FreeCount(), 0);
+}
+
+/**
+ * More blocked acquirers than leaves: every thread must get through all its
+ * iterations without spinning, and the tree must end up full.
+ */
+TEST(SignalTreeTest, MultiThreadAcquireBlocking) {
+  const int kLeaves = 4;
+  const int kThreads = 8;
+  const int kIterations = 200;
+
+  signal_tree::SignalTree st(kLeaves);
+  std::vector<std::atomic<bool>> ownership(kLeaves);
+  std::atomic<int> total(0);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&]() {
+      for (int i = 0; i < kIterations; ++i) {
+        const int leaf = st.AcquireBlocking();
+        ASSERT_GE(leaf, 0);
+        EXPECT_FALSE(ownership[leaf].exchange(true));
+        total.fetch_add(1);
+        ownership[leaf].store(false);
+        st.Release(leaf);
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  EXPECT_EQ(total.load(), kThreads * kIterations);
+  EXPECT_EQ(st.FreeCount(), kLeaves);
+}
@@ -0,0 +1,114 @@
+#include <atomic>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "signal_tree/weighted_signal_tree.h"
+
+TEST(WeightedSignalTreeTest, BasicInitializationTest) {
+  const std::vector<int> capacities{4, 1, 8};
+  signal_tree::WeightedSignalTree st(capacities);
+  EXPECT_EQ(st.Size(), 3);
+  EXPECT_EQ(st.FreeUnits(), 13);
+  EXPECT_EQ(st.MaxAcquirable(), 8);
+  EXPECT_EQ(st.Capacity(2), 8);
+  EXPECT_EQ(st.FreeUnits(1), 1);
+
+  EXPECT_THROW(signal_tree::WeightedSignalTree(std::vector<int>{}),
+               std::runtime_error);
+  EXPECT_THROW(signal_tree::WeightedSignalTree(std::vector<int>{1, -1}),
+               std::runtime_error);
+}
+
+TEST(WeightedSignalTreeTest, AcquireFindsLeafWithEnoughUnits) {
+  const std::vector<int> capacities{2, 3, 8, 1, 5};
+  signal_tree::WeightedSignalTree st(capacities);
+
+  // First fit: the leftmost leaf that can serve the whole request.
+  EXPECT_EQ(st.Acquire(3), 1);
+  EXPECT_EQ(st.Acquire(6), 2);
+  EXPECT_EQ(st.Acquire(4), 4);
+  EXPECT_EQ(st.MaxAcquirable(), 2);
+  EXPECT_EQ(st.FreeUnits(), 19 - 13);
+
+  // Six units are free in total, but no leaf has three of them.
+  EXPECT_EQ(st.Acquire(3), -1);
+  EXPECT_EQ(st.Acquire(2), 0);
+  EXPECT_EQ(st.Acquire(2), 2);
+  EXPECT_EQ(st.Acquire(1), 3);
+  EXPECT_EQ(st.Acquire(1), 4);
+  EXPECT_EQ(st.FreeUnits(), 0);
+  EXPECT_EQ(st.Acquire(1), -1);
+
+  st.Release(2, 8);
+  EXPECT_EQ(st.MaxAcquirable(), 8);
+  EXPECT_EQ(st.Acquire(7), 2);
+}
+
+TEST(WeightedSignalTreeTest, ReleaseErrors) {
+  const std::vector<int> capacities{2, 2};
+  signal_tree::WeightedSignalTree st(capacities);
+
+  EXPECT_THROW(st.Acquire(0), std::runtime_error);
+  EXPECT_EQ(st.Acquire(2), 0);
+  EXPECT_THROW(st.Release(-1, 1), std::runtime_error);
+  EXPECT_THROW(st.Release(2, 1), std::runtime_error);
+  EXPECT_THROW(st.Release(0, 0), std::runtime_error);
+  EXPECT_THROW(st.Release(0, 3), std::runtime_error);
+  EXPECT_THROW(st.Release(1, 1), std::runtime_error);
+
+  st.Release(0, 1);
+  st.Release(0, 1);
+  EXPECT_THROW(st.Release(0, 1), std::runtime_error);
+  EXPECT_EQ(st.FreeUnits(), 4);
+}
+
+/**
+ * Threads acquire and release requests of different sizes. Per-leaf usage
+ * counters catch a leaf handing out more units than it has, and every unit
+ * must be back once all threads are done.
+ */
+TEST(WeightedSignalTreeTest, MultiThreadUnitAccounting) {
+  constexpr int kLeaves = 13;
+  constexpr int kThreads = 8;
+  constexpr int kIterations = 20000;
+
+  std::vector<int> capacities;
+  int total = 0;
+  for (int i = 0; i < kLeaves; ++i) {
+    capacities.push_back(1 + i % 5);
+    total += capacities.back();
+  }
+  signal_tree::WeightedSignalTree st(capacities);
+  std::vector<std::atomic<int>> used(kLeaves);
+  std::atomic<int> errors{0};
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < kIterations; ++i) {
+        const int units = 1 + (t + i) % 4;
+        const int leaf = st.Acquire(units);
+        if (leaf < 0) {
+          continue;
+        }
+        if (used[leaf].fetch_add(units) + units > capacities[leaf]) {
+          errors.fetch_add(1);
+        }
+        used[leaf].fetch_sub(units);
+        st.Release(leaf, units);
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  EXPECT_EQ(errors.load(), 0);
+  EXPECT_EQ(st.FreeUnits(), total);
+  EXPECT_EQ(st.MaxAcquirable(), 5);
+  for (int i = 0; i < kLeaves; ++i) {
+    EXPECT_EQ(st.FreeUnits(i), capacities[i]);
+  }
+}
@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <stdexcept>
+#include <vector>
+
+#include "metrics/metrics.h"
+#include "signal_tree/weighted_signal_tree.h"
+
+namespace signal_tree {
+
+WeightedSignalTree::WeightedSignalTree(std::span<const int> capacities)
+    : capacities_(capacities.begin(), capacities.end()),
+      leaves_(std::bit_ceil(std::max<size_t>(capacities.size(), 1))),
+      nodes_(new std::atomic<int>[2 * leaves_]) {
+  if (capacities_.empty()) {
+    throw std::runtime_error("WeightedSignalTree needs at least one leaf!");
+  }
+
+  int total = 0;
+  for (size_t i = 0; i < leaves_; ++i) {
+    int units = 0;
+    if (i < capacities_.size()) {
+      units = capacities_[i];
+      if (units < 0) {
+        throw std::runtime_error("Leaf capacity must not be negative!");
+      }
+    }
+    At(leaves_ + i).store(units, std::memory_order_relaxed);
+    total += units;
+  }
+  for (size_t i = leaves_ - 1; i > 0; --i) {
+    At(i).store(std::max(At(2 * i).load(std::memory_order_relaxed),
+                         At(2 * i + 1).load(std::memory_order_relaxed)),
+                std::memory_order_relaxed);
+  }
+  total_.store(total, std::memory_order_release);
+}
+
+const int WeightedSignalTree::Acquire(const int units) {
+  if (units <= 0) {
+    throw std::runtime_error("Acquire() called with non-positive units!");
+  }
+
+  while (true) {
+    if (total_.load(std::memory_order_acquire) < units ||
+        At(1).load(std::memory_order_acquire) < units) {
+      return -1;
+    }
+
+    // First fit: take the left child whenever its maximum is large enough.
+    size_t idx = 1;
+    while (idx < leaves_) {
+      if (At(2 * idx).load(std::memory_order_acquire) >= units) {
+        idx = 2 * idx;
+      } else if (At(2 * idx + 1).load(std::memory_order_acquire) >= units) {
+        idx = 2 * idx + 1;
+      } else {
+        break;
+      }
+    }
+
+    if (idx >= leaves_) {
+      int free = At(idx).load(std::memory_order_acquire);
+      while (free >= units) {
+        if (At(idx).compare_exchange_weak(free, free - units,
+                                          std::memory_order_acq_rel)) {
+          total_.fetch_sub(units, std::memory_order_acq_rel);
+          RefreshPath(idx / 2);
+          return static_cast<int>(idx - leaves_);
+        }
+      }
+    }
+
+    // The maxima on this path were stale: either a concurrent acquirer took
+    // the units first, or its refresh has not reached this node yet. Fix the
+    // path so the next descent (or the root check) sees the truth.
+    LFWP_METRIC_COUNT("weighted_signal_tree.acquire.restarts", 1);
+    RefreshPath(idx >= leaves_ ? idx / 2 : idx);
+  }
+}
+
+void WeightedSignalTree::Release(const int index, const int units) {
+  if (index < 0 || static_cast<size_t>(index) >= capacities_.size()) {
+    throw std::runtime_error("Release() called with invalid index!");
+  }
+  if (units <= 0) {
+    throw std::runtime_error("Release() called with non-positive units!");
+  }
+
+  const size_t leaf = leaves_ + static_cast<size_t>(index);
+  int free = At(leaf).load(std::memory_order_relaxed);
+  do {
+    if (free + units > capacities_[index]) {
+      throw std::runtime_error("Releasing more units than the leaf holds!");
+    }
+  } while (!At(leaf).compare_exchange_weak(free, free + units,
+                                           std::memory_order_acq_rel));
+  total_.fetch_add(units, std::memory_order_acq_rel);
+  RefreshPath(leaf / 2);
+}
+
+void WeightedSignalTree::RefreshPath(size_t node) {
+  // Store-then-recheck: after publishing the maximum, read the children
+  // again. If one of them changed in between, the stored value may already
+  // be stale, so store again; otherwise any later change of a child is
+  // followed by its own refresh of this node.
+  for (; node > 0; node /= 2) {
+    while (true) {
+      const int max =
+          std::max(At(2 * node).load(std::memory_order_acquire),
+                   At(2 * node + 1).load(std::memory_order_acquire));
+      At(node).store(max, std::memory_order_seq_cst);
+      if (std::max(At(2 * node).load(std::memory_order_seq_cst),
+                   At(2 * node + 1).load(std::memory_order_seq_cst)) == max) {
+        break;
+      }
+    }
+  }
+}
+
+const int WeightedSignalTree::FreeUnits(const int index) const {
+  if (index < 0 || static_cast<size_t>(index) >= capacities_.size()) {
+    throw std::runtime_error("FreeUnits() called with invalid index!");
+  }
+  return At(leaves_ + static_cast<size_t>(index))
+      .load(std::memory_order_acquire);
+}
+
+const int WeightedSignalTree::Capacity(const int index) const {
+  if (index < 0 || static_cast<size_t>(index) >= capacities_.size()) {
+    throw std::runtime_error("Capacity() called with invalid index!");
+  }
+  return capacities_[index];
+}
+
+} // namespace signal_tree
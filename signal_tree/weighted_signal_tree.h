@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace signal_tree {
+
+// Signal tree whose leaves hold several units each, e.g. the connection
+// slots of one backend.
+//
+// Leaf i holds between 0 and capacities[i] free units. An internal node
+// holds the largest number of free units found in a single leaf below it, so
+// Acquire(units) descends to the first leaf that can serve the whole request
+// instead of summing counts that may be spread over several leaves. Leaves
+// are updated with a CAS, after which the maxima on the path to the root are
+// refreshed. A separate counter tracks the total number of free units.
+//
+// Maxima are hints that briefly lag behind concurrent updates. A descent
+// that finds a leaf short of units refreshes its path and starts over, so
+// Acquire() only fails once the root shows no leaf with enough units.
+class WeightedSignalTree {
+public:
+  // One leaf per entry of `capacities`, each starting with all of its units
+  // free. Throws if `capacities` is empty or has a negative entry.
+  explicit WeightedSignalTree(std::span<const int> capacities);
+
+  ~WeightedSignalTree() = default;
+
+  // Takes `units` (> 0) units from the first leaf that has that many free
+  // and returns its index, or -1 if no leaf has.
+  const int Acquire(const int units);
+
+  // Gives `units` (> 0) units back to leaf `index`. Throws if the index is
+  // out of range or the leaf would hold more than its capacity.
+  void Release(const int index, const int units);
+
+  // Free units of leaf `index`.
+  const int FreeUnits(const int index) const;
+
+  // Total number of free units in the tree.
+  const int FreeUnits() const {
+    return total_.load(std::memory_order_acquire);
+  }
+
+  // Largest request Acquire() can currently serve.
+  const int MaxAcquirable() const {
+    return At(1).load(std::memory_order_acquire);
+  }
+
+  // Number of leaves.
+  const size_t Size() const { return capacities_.size(); }
+
+  // Units of leaf `index` when all of them are free.
+  const int Capacity(const int index) const;
+
+  // Non-copyable, non-assignable
+  WeightedSignalTree(const WeightedSignalTree &) = delete;
+  WeightedSignalTree &operator=(const WeightedSignalTree &) = delete;
+
+private:
+  // Recomputes the maxima on the path from `node` to the root.
+  void RefreshPath(size_t node);
+
+  std::atomic<int> &At(const size_t i) { return nodes_[i]; }
+  const std::atomic<int> &At(const size_t i) const { return nodes_[i]; }
+
+  const std::vector<int> capacities_;
+  // Leaf level width: Size() rounded up to a power of two. The padding
+  // leaves hold 0 units.
+  const size_t leaves_;
+
+  // Same segment-tree layout as SignalTree: node i has children 2*i and
+  // 2*i + 1, the leaves are [leaves_..2*leaves_-1].
+  std::unique_ptr<std::atomic<int>[]> nodes_;
+
+  alignas(64) std::atomic<int> total_{0};
+};
+
+} // namespace signal_tree
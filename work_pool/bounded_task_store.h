@@ -0,0 +1,273 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+
+#include "work_pool/event_count.h"
+#include "work_pool/task_store.h"
+
+namespace work_pool {
+
+// Fixed-capacity task store with backpressure.
+//
+// Tasks live in a ring of preallocated cells (Vyukov's bounded MPMC queue),
+// so memory use does not depend on load. What happens when the ring is full
+// is chosen by `Overflow`. Optional high/low watermark callbacks let upstream
+// stages throttle before the ring fills up: `on_high` runs when the depth
+// reaches `high_watermark`, and `on_low` once it falls back to
+// `low_watermark`, so they alternate instead of firing on every task.
+class BoundedTaskStore : public TaskStore<BoundedTaskStore> {
+public:
+  using Base = TaskStore<BoundedTaskStore>;
+  using Task = typename Base::Task;
+
+  enum class Overflow {
+    // The producer waits until a consumer makes room.
+    kBlock,
+    // Enqueue()/Submit*() throw; use TryEnqueue()/TrySubmit() to get false.
+    kFailFast,
+    // The producer runs the task itself.
+    kCallerRuns,
+    // The oldest queued task is destroyed to make room. Futures of dropped
+    // tasks report std::future_errc::broken_promise.
+    kDropOldest,
+  };
+
+  struct Options {
+    // Rounded up to a power of two, at least 2.
+    size_t capacity = 1024;
+    Overflow overflow = Overflow::kBlock;
+    // 0 disables the watermark callbacks.
+    size_t high_watermark = 0;
+    size_t low_watermark = 0;
+    std::function<void()> on_high;
+    std::function<void()> on_low;
+  };
+
+  explicit BoundedTaskStore(Options options)
+      : options_(std::move(options)),
+        mask_(RoundUpToPowerOfTwo(std::max<size_t>(options_.capacity, 2)) -
+              1),
+        cells_(new Cell[mask_ + 1]) {
+    if (options_.high_watermark > 0 &&
+        options_.low_watermark >= options_.high_watermark) {
+      throw std::runtime_error(
+          "BoundedTaskStore low watermark must be below the high watermark!");
+    }
+    for (size_t i = 0; i <= mask_; ++i) {
+      cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  ~BoundedTaskStore() = default;
+
+  // Number of cells.
+  const size_t Capacity() const { return mask_ + 1; }
+
+  // Number of tasks destroyed by Overflow::kDropOldest.
+  const uint64_t Dropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+  // Enqueues `task` if there is room. On failure `task` is left untouched.
+  bool TryEnqueue(Task &task) {
+    if (!TryPush(task)) {
+      return false;
+    }
+    Idle().NotifyOne();
+    return true;
+  }
+
+  // Like Submit(), but returns false instead of applying the overflow policy
+  // when the store is full.
+  template <typename FuncType, typename CallbackType, typename... Args>
+  bool TrySubmit(FuncType &&func, CallbackType &&callback, Args &&...args) {
+    Task task = MakeTask(std::forward<FuncType>(func),
+                         std::forward<CallbackType>(callback),
+                         std::forward<Args>(args)...);
+    return TryEnqueue(task);
+  }
+
+  void EnqueueImpl(Task task) {
+    if (TryPush(task)) {
+      return;
+    }
+    switch (options_.overflow) {
+    case Overflow::kBlock:
+      while (true) {
+        const EventCount::Key key = not_full_.PrepareWait();
+        if (TryPush(task)) {
+          not_full_.CancelWait();
+          return;
+        }
+        not_full_.Wait(key);
+      }
+    case Overflow::kFailFast:
+      throw std::runtime_error("BoundedTaskStore is full!");
+    case Overflow::kCallerRuns:
+      task();
+      return;
+    case Overflow::kDropOldest:
+      while (!TryPush(task)) {
+        Task oldest;
+        if (TryPop(oldest)) {
+          dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+      return;
+    }
+  }
+
+  bool TryDequeueImpl(Task &task) {
+    if (!TryPop(task)) {
+      return false;
+    }
+    not_full_.NotifyOne();
+    return true;
+  }
+
+  void WaitDequeueImpl(Task &task) {
+    while (!WaitDequeueUntil(task,
+                             std::chrono::steady_clock::time_point::max())) {
+    }
+  }
+
+  template <class Rep, class Period>
+  bool
+  WaitDequeueTimedImpl(Task &task,
+                       const std::chrono::duration<Rep, Period> &duration) {
+    return WaitDequeueUntil(task, std::chrono::steady_clock::now() + duration);
+  }
+
+  size_t SizeApproxImpl() const {
+    const size_t tail = dequeue_pos_.load(std::memory_order_relaxed);
+    const size_t head = enqueue_pos_.load(std::memory_order_relaxed);
+    return head > tail ? head - tail : 0;
+  }
+
+  BoundedTaskStore(const BoundedTaskStore &) = delete;
+  BoundedTaskStore &operator=(const BoundedTaskStore &) = delete;
+
+private:
+  struct Cell {
+    // pos when free for the enqueue at pos, pos + 1 once that enqueue
+    // published its task.
+    std::atomic<size_t> seq;
+    Task task;
+  };
+
+  static size_t RoundUpToPowerOfTwo(const size_t n) {
+    size_t capacity = 1;
+    while (capacity < n) {
+      capacity <<= 1;
+    }
+    return capacity;
+  }
+
+  bool TryPush(Task &task) {
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    Cell *cell;
+    while (true) {
+      cell = &cells_[pos & mask_];
+      const size_t seq = cell->seq.load(std::memory_order_acquire);
+      const intptr_t diff =
+          static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false; // Full.
+      } else {
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+    cell->task = std::move(task);
+    cell->seq.store(pos + 1, std::memory_order_release);
+    CheckHighWatermark();
+    return true;
+  }
+
+  bool TryPop(Task &task) {
+    size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    Cell *cell;
+    while (true) {
+      cell = &cells_[pos & mask_];
+      const size_t seq = cell->seq.load(std::memory_order_acquire);
+      const intptr_t diff =
+          static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (dequeue_pos_.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false; // Empty.
+      } else {
+        pos = dequeue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+    task = std::move(cell->task);
+    cell->seq.store(pos + mask_ + 1, std::memory_order_release);
+    CheckLowWatermark();
+    return true;
+  }
+
+  bool WaitDequeueUntil(Task &task,
+                        const std::chrono::steady_clock::time_point deadline) {
+    // Every enqueue notifies Idle(), so blocking consumers park there too.
+    EventCount &event = Idle().Event();
+    while (true) {
+      if (TryDequeueImpl(task)) {
+        return true;
+      }
+      const EventCount::Key key = event.PrepareWait();
+      if (TryDequeueImpl(task)) {
+        event.CancelWait();
+        return true;
+      }
+      if (!event.WaitUntil(key, deadline)) {
+        return TryDequeueImpl(task);
+      }
+    }
+  }
+
+  void CheckHighWatermark() {
+    if (options_.high_watermark > 0 &&
+        SizeApproxImpl() >= options_.high_watermark &&
+        !above_high_.exchange(true, std::memory_order_acq_rel) &&
+        options_.on_high) {
+      options_.on_high();
+    }
+  }
+
+  void CheckLowWatermark() {
+    if (options_.high_watermark > 0 &&
+        above_high_.load(std::memory_order_relaxed) &&
+        SizeApproxImpl() <= options_.low_watermark &&
+        above_high_.exchange(false, std::memory_order_acq_rel) &&
+        options_.on_low) {
+      options_.on_low();
+    }
+  }
+
+  const Options options_;
+  const size_t mask_;
+  std::unique_ptr<Cell[]> cells_;
+
+  alignas(64) std::atomic<size_t> enqueue_pos_{0};
+  alignas(64) std::atomic<size_t> dequeue_pos_{0};
+  alignas(64) std::atomic<bool> above_high_{false};
+  std::atomic<uint64_t> dropped_{0};
+
+  // Producers blocked by Overflow::kBlock.
+  EventCount not_full_;
+};
+
+} // namespace work_pool
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+namespace work_pool {
+
+// Chase-Lev work-stealing deque ("Dynamic Circular Work-Stealing Deque",
+// with the C11 memory orderings from Lê et al., PPoPP'13).
+//
+// The owning thread pushes and pops at the bottom (LIFO); any other thread
+// steals from the top (FIFO). Items are read by thieves before they know if
+// they won the race, so T must be trivially copyable (typically a pointer).
+// The ring grows on demand; outgrown buffers are kept until destruction since
+// a thief may still be reading from them.
+template <typename T> class ChaseLevDeque {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "ChaseLevDeque items must be trivially copyable");
+
+public:
+  explicit ChaseLevDeque(const size_t capacity = 256)
+      : buffer_(new Buffer(RoundUpToPowerOfTwo(capacity))) {
+    buffers_.emplace_back(buffer_.load(std::memory_order_relaxed));
+  }
+
+  ~ChaseLevDeque() = default;
+
+  // Owner only. Pushes an item at the bottom.
+  void Push(T item) {
+    const int64_t b = bottom_.load(std::memory_order_relaxed);
+    const int64_t t = top_.load(std::memory_order_acquire);
+    Buffer *buffer = buffer_.load(std::memory_order_relaxed);
+    if (b - t > static_cast<int64_t>(buffer->mask)) {
+      buffer = Grow(buffer, t, b);
+    }
+    buffer->Put(b, item);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+  }
+
+  // Owner only. Pops the most recently pushed item.
+  std::optional<T> Pop() {
+    const int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    Buffer *buffer = buffer_.load(std::memory_order_relaxed);
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top_.load(std::memory_order_relaxed);
+
+    if (t > b) {
+      // Empty.
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return std::nullopt;
+    }
+
+    T item = buffer->Get(b);
+    if (t == b) {
+      // Last item: race the thieves for it.
+      const bool won = top_.compare_exchange_strong(
+          t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      if (!won) {
+        return std::nullopt;
+      }
+    }
+    return item;
+  }
+
+  // Any thread. Steals the least recently pushed item. Returns nullopt if the
+  // deque is empty or another thread won the race for the top item.
+  std::optional<T> Steal() {
+    int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64_t b = bottom_.load(std::memory_order_acquire);
+
+    if (t >= b) {
+      return std::nullopt;
+    }
+    T item = buffer_.load(std::memory_order_acquire)->Get(t);
+    if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      return std::nullopt;
+    }
+    return item;
+  }
+
+  // Number of items; exact only when called by the owner with no thieves.
+  size_t SizeApprox() const {
+    const int64_t b = bottom_.load(std::memory_order_relaxed);
+    const int64_t t = top_.load(std::memory_order_relaxed);
+    return b > t ? static_cast<size_t>(b - t) : 0;
+  }
+
+  ChaseLevDeque(const ChaseLevDeque &) = delete;
+  ChaseLevDeque &operator=(const ChaseLevDeque &) = delete;
+
+private:
+  struct Buffer {
+    explicit Buffer(const size_t capacity)
+        : mask(capacity - 1), items(new std::atomic<T>[capacity]) {}
+
+    T Get(const int64_t i) const {
+      return items[static_cast<size_t>(i) & mask].load(
+          std::memory_order_relaxed);
+    }
+    void Put(const int64_t i, T item) {
+      items[static_cast<size_t>(i) & mask].store(item,
+                                                 std::memory_order_relaxed);
+    }
+
+    const size_t mask;
+    std::unique_ptr<std::atomic<T>[]> items;
+  };
+
+  static size_t RoundUpToPowerOfTwo(const size_t n) {
+    size_t capacity = 1;
+    while (capacity < n) {
+      capacity <<= 1;
+    }
+    return capacity;
+  }
+
+  Buffer *Grow(Buffer *old, const int64_t t, const int64_t b) {
+    auto *grown = new Buffer(2 * (old->mask + 1));
+    for (int64_t i = t; i < b; ++i) {
+      grown->Put(i, old->Get(i));
+    }
+    buffers_.emplace_back(grown);
+    buffer_.store(grown, std::memory_order_release);
+    return grown;
+  }
+
+  alignas(64) std::atomic<int64_t> top_{0};
+  alignas(64) std::atomic<int64_t> bottom_{0};
+  alignas(64) std::atomic<Buffer *> buffer_;
+
+  // Every buffer ever used (owner only).
+  std::vector<std::unique_ptr<Buffer>> buffers_;
+};
+
+} // namespace work_pool
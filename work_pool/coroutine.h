@@ -0,0 +1,422 @@
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "work_pool/task.h"
+
+namespace work_pool::coro {
+
+// Recycles coroutine frames.
+//
+// Frames are rounded up to a power-of-two size class and go back to that
+// class's free list when the coroutine ends, so a steady stream of
+// coroutines stops hitting malloc. Frames above kMaxPooledSize bypass the
+// pool. Every frame records its allocator, so a frame may end on any thread.
+// Frames must not outlive their allocator.
+//
+// A coroutine returning coro::Task<T> takes its frame from, in order: a
+// FrameAllocator& parameter of the coroutine, the calling thread's current
+// allocator (set by Scope; ThreadPool sets its own on every worker), or the
+// global operator new.
+class FrameAllocator {
+public:
+  static constexpr size_t kMinPooledSize = 64;
+  static constexpr size_t kMaxPooledSize = 4096;
+
+  FrameAllocator() = default;
+
+  ~FrameAllocator() {
+    for (auto &list : free_lists_) {
+      for (void *block : list.blocks) {
+        ::operator delete(block);
+      }
+    }
+  }
+
+  void *Allocate(const size_t size) {
+    const size_t cls = SizeClass(size);
+    if (cls == kNumClasses) {
+      return ::operator new(size);
+    }
+    {
+      FreeList &list = free_lists_[cls];
+      std::lock_guard<std::mutex> lock(list.mutex);
+      if (!list.blocks.empty()) {
+        void *block = list.blocks.back();
+        list.blocks.pop_back();
+        return block;
+      }
+    }
+    return ::operator new(kMinPooledSize << cls);
+  }
+
+  void Deallocate(void *block, const size_t size) {
+    const size_t cls = SizeClass(size);
+    if (cls == kNumClasses) {
+      ::operator delete(block);
+      return;
+    }
+    FreeList &list = free_lists_[cls];
+    std::lock_guard<std::mutex> lock(list.mutex);
+    list.blocks.push_back(block);
+  }
+
+  // Number of pooled frames waiting for reuse.
+  const size_t FreeBlocks() {
+    size_t total = 0;
+    for (auto &list : free_lists_) {
+      std::lock_guard<std::mutex> lock(list.mutex);
+      total += list.blocks.size();
+    }
+    return total;
+  }
+
+  // The calling thread's current allocator, or nullptr.
+  static FrameAllocator *Current() { return current_; }
+
+  // Makes `allocator` the calling thread's current allocator while alive.
+  class Scope {
+  public:
+    explicit Scope(FrameAllocator &allocator) : previous_(current_) {
+      current_ = &allocator;
+    }
+    ~Scope() { current_ = previous_; }
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    FrameAllocator *previous_;
+  };
+
+  FrameAllocator(const FrameAllocator &) = delete;
+  FrameAllocator &operator=(const FrameAllocator &) = delete;
+
+private:
+  static constexpr size_t kNumClasses = 7; // 64 B ... 4 KiB
+
+  static size_t SizeClass(const size_t size) {
+    size_t cls = 0;
+    while (cls < kNumClasses && (kMinPooledSize << cls) < size) {
+      ++cls;
+    }
+    return cls;
+  }
+
+  struct alignas(64) FreeList {
+    std::mutex mutex;
+    std::vector<void *> blocks;
+  };
+
+  static inline thread_local FrameAllocator *current_ = nullptr;
+
+  std::array<FreeList, kNumClasses> free_lists_;
+};
+
+template <class T = void> class Task;
+
+namespace internal {
+
+// Prepended to every frame so it can be freed without knowing its allocator.
+struct alignas(std::max_align_t) FrameHeader {
+  FrameAllocator *allocator;
+  size_t size;
+};
+
+inline void *AllocateFrame(const size_t size, FrameAllocator *allocator) {
+  const size_t total = sizeof(FrameHeader) + size;
+  void *block = allocator != nullptr ? allocator->Allocate(total)
+                                     : ::operator new(total);
+  auto *header = ::new (block) FrameHeader{allocator, total};
+  return header + 1;
+}
+
+inline void FreeFrame(void *frame) {
+  auto *header = static_cast<FrameHeader *>(frame) - 1;
+  FrameAllocator *allocator = header->allocator;
+  const size_t total = header->size;
+  if (allocator != nullptr) {
+    allocator->Deallocate(header, total);
+  } else {
+    ::operator delete(header);
+  }
+}
+
+class PromiseBase {
+public:
+  template <class... Args>
+  static void *operator new(const size_t size, Args &...args) {
+    FrameAllocator *allocator = FrameAllocator::Current();
+    (
+        [&] {
+          if constexpr (std::is_same_v<std::remove_cvref_t<Args>,
+                                       FrameAllocator>) {
+            allocator = &args;
+          }
+        }(),
+        ...);
+    return AllocateFrame(size, allocator);
+  }
+
+  static void operator delete(void *frame) noexcept { FreeFrame(frame); }
+
+  // Resumes whoever awaited this coroutine, without growing the stack.
+  struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+
+    template <class Promise>
+    std::coroutine_handle<>
+    await_suspend(std::coroutine_handle<Promise> handle) const noexcept {
+      if (auto continuation = handle.promise().continuation_) {
+        return continuation;
+      }
+      return std::noop_coroutine();
+    }
+
+    void await_resume() const noexcept {}
+  };
+
+  // Tasks are lazy: nothing runs until the task is awaited.
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+  FinalAwaiter final_suspend() const noexcept { return {}; }
+
+  void unhandled_exception() noexcept { error_ = std::current_exception(); }
+
+  void SetContinuation(std::coroutine_handle<> continuation) {
+    continuation_ = continuation;
+  }
+
+protected:
+  std::coroutine_handle<> continuation_;
+  std::exception_ptr error_;
+};
+
+template <class T> class Promise : public PromiseBase {
+public:
+  Task<T> get_return_object() noexcept;
+
+  template <class U> void return_value(U &&value) {
+    value_.emplace(std::forward<U>(value));
+  }
+
+  T Result() {
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+    return std::move(*value_);
+  }
+
+private:
+  std::optional<T> value_;
+};
+
+template <> class Promise<void> : public PromiseBase {
+public:
+  Task<void> get_return_object() noexcept;
+
+  void return_void() noexcept {}
+
+  void Result() {
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+  }
+};
+
+} // namespace internal
+
+// Lazily started coroutine producing a T.
+//
+// co_await-ing a Task starts it by symmetric transfer and the task resumes
+// its awaiter the same way when it finishes, so chains of awaits that
+// complete synchronously run inline without touching a queue or growing the
+// stack. Use TaskStore::Schedule() to hop onto a pool worker, and SyncWait()
+// to run a task from ordinary code.
+template <class T> class [[nodiscard]] Task {
+public:
+  using promise_type = internal::Promise<T>;
+  using Handle = std::coroutine_handle<promise_type>;
+
+  Task() = default;
+  explicit Task(Handle handle) : handle_(handle) {}
+
+  Task(Task &&other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+  Task &operator=(Task &&other) noexcept {
+    if (this != &other) {
+      if (handle_) {
+        handle_.destroy();
+      }
+      handle_ = std::exchange(other.handle_, {});
+    }
+    return *this;
+  }
+
+  ~Task() {
+    if (handle_) {
+      handle_.destroy();
+    }
+  }
+
+  auto operator co_await() && noexcept { return Awaiter{handle_}; }
+  auto operator co_await() & noexcept { return Awaiter{handle_}; }
+
+  Task(const Task &) = delete;
+  Task &operator=(const Task &) = delete;
+
+private:
+  struct Awaiter {
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<>
+    await_suspend(std::coroutine_handle<> awaiting) noexcept {
+      handle.promise().SetContinuation(awaiting);
+      return handle;
+    }
+
+    T await_resume() { return handle.promise().Result(); }
+
+    Handle handle;
+  };
+
+  Handle handle_;
+};
+
+namespace internal {
+
+template <class T> Task<T> Promise<T>::get_return_object() noexcept {
+  return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline Task<void> Promise<void>::get_return_object() noexcept {
+  return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+// Eagerly started coroutine used by SyncWait(): signals `done` from its
+// final suspend point and is destroyed by the waiting thread.
+class SyncWaitTask {
+public:
+  struct Signal {
+    std::mutex mutex;
+    std::condition_variable done_cv;
+    bool done = false;
+  };
+
+  struct promise_type {
+    SyncWaitTask get_return_object() noexcept {
+      return SyncWaitTask(
+          std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_never initial_suspend() const noexcept { return {}; }
+
+    struct FinalAwaiter {
+      bool await_ready() const noexcept { return false; }
+      void await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+        Signal &signal = *handle.promise().signal;
+        // Notify under the lock: the waiter may destroy `signal` as soon as
+        // it can take the lock.
+        std::lock_guard<std::mutex> lock(signal.mutex);
+        signal.done = true;
+        signal.done_cv.notify_all();
+      }
+      void await_resume() const noexcept {}
+    };
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+
+    // The coroutine runs right away, so it receives `signal` through its
+    // first parameter rather than after creation.
+    template <class... Args>
+    explicit promise_type(Signal &signal, Args &...) : signal(&signal) {}
+
+    void return_void() noexcept {}
+    void unhandled_exception() noexcept { std::terminate(); }
+
+    Signal *signal;
+  };
+
+  explicit SyncWaitTask(std::coroutine_handle<promise_type> handle)
+      : handle_(handle) {}
+  ~SyncWaitTask() { handle_.destroy(); }
+
+  SyncWaitTask(const SyncWaitTask &) = delete;
+  SyncWaitTask &operator=(const SyncWaitTask &) = delete;
+
+private:
+  std::coroutine_handle<promise_type> handle_;
+};
+
+} // namespace internal
+
+// Suspends the awaiting coroutine and resumes it on a worker of `Store`.
+// The coroutine handle travels as a one-pointer inline Task.
+template <class Store> class ScheduleAwaiter {
+public:
+  explicit ScheduleAwaiter(Store &store) : store_(store) {}
+
+  bool await_ready() const noexcept { return false; }
+
+  void await_suspend(std::coroutine_handle<> handle) {
+    store_.Enqueue(work_pool::Task([handle]() { handle.resume(); }));
+  }
+
+  void await_resume() const noexcept {}
+
+private:
+  Store &store_;
+};
+
+namespace internal {
+
+template <class T, class Result>
+SyncWaitTask RunSync(SyncWaitTask::Signal &, Task<T> &task, Result &result,
+                     std::exception_ptr &error) {
+  try {
+    if constexpr (std::is_void_v<T>) {
+      co_await task;
+      result.emplace();
+    } else {
+      result.emplace(co_await task);
+    }
+  } catch (...) {
+    error = std::current_exception();
+  }
+}
+
+} // namespace internal
+
+// Runs `task` on the calling thread until it first suspends (e.g. by hopping
+// onto a pool with Schedule()) and blocks until it finishes. Returns its
+// value or rethrows its exception. Must not be called from a pool worker the
+// task needs.
+template <class T> T SyncWait(Task<T> task) {
+  internal::SyncWaitTask::Signal signal;
+  std::optional<std::conditional_t<std::is_void_v<T>, std::monostate, T>>
+      result;
+  std::exception_ptr error;
+
+  internal::SyncWaitTask waiter =
+      internal::RunSync<T>(signal, task, result, error);
+  {
+    std::unique_lock<std::mutex> lock(signal.mutex);
+    signal.done_cv.wait(lock, [&signal] { return signal.done; });
+  }
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  if constexpr (!std::is_void_v<T>) {
+    return std::move(*result);
+  }
+}
+
+} // namespace work_pool::coro
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+namespace work_pool {
+
+// Event count: lets consumers sleep until "something changed" without a lost
+// wakeup and without producers paying for a lock when nobody sleeps.
+//
+// A consumer announces itself, re-checks its condition and only then sleeps:
+//
+//   auto key = ec.PrepareWait();
+//   if (TryDequeue(task)) { ec.CancelWait(); ... }
+//   else { ec.Wait(key); }
+//
+// A producer publishes its change and calls NotifyOne()/NotifyAll(). Both
+// sides order their change against the waiter count with seq_cst operations,
+// so either the consumer's re-check sees the change or the producer sees the
+// waiter. With no waiters a notification is a fence and one load.
+class EventCount {
+public:
+  using Key = uint32_t;
+
+  EventCount() = default;
+
+  // Registers the calling thread as a waiter. Must be followed by exactly one
+  // of CancelWait(), Wait() or WaitUntil().
+  Key PrepareWait() {
+    waiters_.fetch_add(1, std::memory_order_seq_cst);
+    return epoch_.load(std::memory_order_seq_cst);
+  }
+
+  // Unregisters a waiter whose re-check succeeded.
+  void CancelWait() { waiters_.fetch_sub(1, std::memory_order_seq_cst); }
+
+  // Sleeps until a notification that happened after PrepareWait() returned
+  // `key`, then unregisters.
+  void Wait(const Key key) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wait_cv_.wait(lock, [&] {
+        return epoch_.load(std::memory_order_relaxed) != key;
+      });
+    }
+    waiters_.fetch_sub(1, std::memory_order_seq_cst);
+  }
+
+  // Same as Wait(), but gives up at `deadline`. Returns false on timeout.
+  template <class Clock, class Duration>
+  const bool
+  WaitUntil(const Key key,
+            const std::chrono::time_point<Clock, Duration> &deadline) {
+    bool notified;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      notified = wait_cv_.wait_until(lock, deadline, [&] {
+        return epoch_.load(std::memory_order_relaxed) != key;
+      });
+    }
+    waiters_.fetch_sub(1, std::memory_order_seq_cst);
+    return notified;
+  }
+
+  // Wakes one waiter, if any.
+  void NotifyOne() {
+    if (HasWaiters()) {
+      Advance();
+      wait_cv_.notify_one();
+    }
+  }
+
+  // Wakes up to `n` waiters.
+  void NotifyMany(const uint32_t n) {
+    if (n == 0 || !HasWaiters()) {
+      return;
+    }
+    Advance();
+    if (n >= waiters_.load(std::memory_order_relaxed)) {
+      wait_cv_.notify_all();
+    } else {
+      for (uint32_t i = 0; i < n; ++i) {
+        wait_cv_.notify_one();
+      }
+    }
+  }
+
+  // Wakes all waiters.
+  void NotifyAll() {
+    if (HasWaiters()) {
+      Advance();
+      wait_cv_.notify_all();
+    }
+  }
+
+  EventCount(const EventCount &) = delete;
+  EventCount &operator=(const EventCount &) = delete;
+
+private:
+  const bool HasWaiters() const {
+    // Orders the caller's preceding writes before the waiter check.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return waiters_.load(std::memory_order_relaxed) > 0;
+  }
+
+  void Advance() {
+    // Bumped under the mutex so a waiter cannot check the epoch and then miss
+    // the notification before it blocks.
+    std::lock_guard<std::mutex> lock(mutex_);
+    epoch_.fetch_add(1, std::memory_order_seq_cst);
+  }
+
+  std::atomic<uint32_t> epoch_{0};
+  std::atomic<uint32_t> waiters_{0};
+  std::mutex mutex_;
+  std::condition_variable wait_cv_;
+};
+
+} // namespace work_pool
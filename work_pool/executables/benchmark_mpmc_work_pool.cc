@@ -0,0 +1,352 @@
+#include "signal_tree/signal_tree.h"
+#include "work_pool/lock_free_mpmc.h"
+#include "work_pool/spsc_task_store.h"
+#include "work_pool/task_store.h"
+#include "work_pool/thread_pool.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Reports the p50/p90/p99/p99.9 of `samples` (nanoseconds) as counters.
+void ReportPercentiles(benchmark::State &state, std::vector<int64_t> &samples,
+                       const benchmark::Counter::Flags flags =
+                           benchmark::Counter::kDefaults) {
+  if (samples.empty()) {
+    return;
+  }
+  std::sort(samples.begin(), samples.end());
+  const auto at = [&](const double q) {
+    const double rank = q * static_cast<double>(samples.size() - 1);
+    return static_cast<double>(samples[static_cast<size_t>(rank)]);
+  };
+  state.counters["p50_ns"] = benchmark::Counter(at(0.50), flags);
+  state.counters["p90_ns"] = benchmark::Counter(at(0.90), flags);
+  state.counters["p99_ns"] = benchmark::Counter(at(0.99), flags);
+  state.counters["p999_ns"] = benchmark::Counter(at(0.999), flags);
+}
+
+// Burns roughly `ns` nanoseconds of CPU.
+void Work(const int64_t ns) {
+  if (ns == 0) {
+    return;
+  }
+  const auto end = Clock::now() + std::chrono::nanoseconds(ns);
+  while (Clock::now() < end) {
+  }
+}
+
+// Baseline: one std::deque behind a mutex, workers sleep on a condition
+// variable.
+class MutexTaskStore : public work_pool::TaskStore<MutexTaskStore> {
+public:
+  using Base = work_pool::TaskStore<MutexTaskStore>;
+  using Task = typename Base::Task;
+
+  void EnqueueImpl(Task task) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queue_.push_back(std::move(task));
+    }
+    ready_.notify_one();
+  }
+
+  bool TryDequeueImpl(Task &task) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return PopLocked(task);
+  }
+
+  void WaitDequeueImpl(Task &task) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    ready_.wait(lock, [this] { return !queue_.empty(); });
+    PopLocked(task);
+  }
+
+  template <class Rep, class Period>
+  bool
+  WaitDequeueTimedImpl(Task &task,
+                       const std::chrono::duration<Rep, Period> &duration) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    ready_.wait_for(lock, duration, [this] { return !queue_.empty(); });
+    return PopLocked(task);
+  }
+
+private:
+  bool PopLocked(Task &task) {
+    if (queue_.empty()) {
+      return false;
+    }
+    task = std::move(queue_.front());
+    queue_.pop_front();
+    return true;
+  }
+
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  std::deque<Task> queue_;
+};
+
+// Classic mutex + condvar pool: workers block in WaitDequeue() and are woken
+// by every enqueue.
+class MutexThreadPool {
+public:
+  MutexThreadPool(MutexTaskStore &store, const size_t num_threads)
+      : store_(store) {
+    for (size_t i = 0; i < num_threads; ++i) {
+      workers_.emplace_back([this] {
+        work_pool::Task task;
+        while (true) {
+          store_.WaitDequeue(task);
+          if (!task) {
+            return; // Poison pill.
+          }
+          task();
+          task.Reset();
+        }
+      });
+    }
+  }
+
+  ~MutexThreadPool() {
+    for (size_t i = 0; i < workers_.size(); ++i) {
+      store_.Enqueue(work_pool::Task());
+    }
+    for (auto &thread : workers_) {
+      thread.join();
+    }
+  }
+
+private:
+  MutexTaskStore &store_;
+  std::vector<std::thread> workers_;
+};
+
+struct LockFreePool {
+  using Store = work_pool::MPMCTaskStore;
+  using Pool = work_pool::ThreadPool<Store>;
+
+  static std::unique_ptr<Pool> Make(Store &store, const size_t num_threads) {
+    auto pool = std::make_unique<Pool>(store, num_threads);
+    pool->Start();
+    return pool;
+  }
+};
+
+struct SpscPool {
+  using Store = work_pool::SpscTaskStore;
+  using Pool = work_pool::ThreadPool<Store>;
+
+  static std::unique_ptr<Pool> Make(Store &store, const size_t num_threads) {
+    auto pool = std::make_unique<Pool>(store, num_threads);
+    pool->Start();
+    return pool;
+  }
+};
+
+struct MutexPool {
+  using Store = MutexTaskStore;
+  using Pool = MutexThreadPool;
+
+  static std::unique_ptr<Pool> Make(Store &store, const size_t num_threads) {
+    return std::make_unique<Pool>(store, num_threads);
+  }
+};
+
+// ---------------------------------------------------------------------------
+// SignalTree
+// ---------------------------------------------------------------------------
+
+std::unique_ptr<signal_tree::SignalTree> tree;
+
+// Every thread acquires a leaf and releases it right away. Every 64th pair is
+// timed for the latency percentiles. Arguments: {leaves}.
+void BM_SignalTreeAcquireRelease(benchmark::State &state) {
+  if (state.thread_index() == 0) {
+    tree = std::make_unique<signal_tree::SignalTree>(
+        static_cast<size_t>(state.range(0)));
+  }
+
+  std::vector<int64_t> samples;
+  int64_t failed = 0;
+  uint64_t n = 0;
+  for (auto _ : state) {
+    const bool timed = (n++ & 63) == 0;
+    const auto start = timed ? Clock::now() : Clock::time_point();
+    const int leaf = tree->Acquire();
+    if (leaf != -1) {
+      tree->Release(leaf);
+    } else {
+      ++failed;
+    }
+    if (timed) {
+      samples.push_back(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                               start)
+              .count());
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations());
+  state.counters["failed"] = benchmark::Counter(
+      static_cast<double>(failed), benchmark::Counter::kAvgIterations);
+  ReportPercentiles(state, samples, benchmark::Counter::kAvgThreads);
+  if (state.thread_index() == 0) {
+    tree.reset();
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Submit-to-execute latency
+// ---------------------------------------------------------------------------
+
+// One producer submits bursts of `kBurst` tasks; each task records the time
+// from its submission to the start of its execution. Arguments: {workers}.
+template <class Kind> void BM_SubmitToExecute(benchmark::State &state) {
+  constexpr int kBurst = 64;
+
+  typename Kind::Store store;
+  auto pool = Kind::Make(store, static_cast<size_t>(state.range(0)));
+
+  std::vector<int64_t> samples;
+  samples.reserve(1 << 20);
+  int64_t burst_latency[kBurst];
+  std::atomic<int> remaining(0);
+
+  for (auto _ : state) {
+    remaining.store(kBurst, std::memory_order_relaxed);
+    for (int i = 0; i < kBurst; ++i) {
+      store.Enqueue(work_pool::Task(
+          [submitted = Clock::now(), slot = &burst_latency[i], &remaining]() {
+            *slot = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        Clock::now() - submitted)
+                        .count();
+            remaining.fetch_sub(1, std::memory_order_release);
+          }));
+    }
+    while (remaining.load(std::memory_order_acquire) > 0) {
+      std::this_thread::yield();
+    }
+    if (samples.size() + kBurst <= samples.capacity()) {
+      samples.insert(samples.end(), burst_latency, burst_latency + kBurst);
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * kBurst);
+  ReportPercentiles(state, samples);
+}
+
+// ---------------------------------------------------------------------------
+// Throughput
+// ---------------------------------------------------------------------------
+
+// One producer submits batches of tasks that each burn `work_ns`, and waits
+// for the batch. Arguments: {work_ns, workers}.
+template <class Kind> void BM_Throughput(benchmark::State &state) {
+  const int64_t work_ns = state.range(0);
+  // Keep a batch at roughly the same wall time for every task size.
+  const int batch = work_ns >= 100000 ? 64 : 1024;
+
+  typename Kind::Store store;
+  auto pool = Kind::Make(store, static_cast<size_t>(state.range(1)));
+
+  std::atomic<int> remaining(0);
+  for (auto _ : state) {
+    remaining.store(batch, std::memory_order_relaxed);
+    for (int i = 0; i < batch; ++i) {
+      store.Enqueue(work_pool::Task([work_ns, &remaining]() {
+        Work(work_ns);
+        remaining.fetch_sub(1, std::memory_order_release);
+      }));
+    }
+    while (remaining.load(std::memory_order_acquire) > 0) {
+      std::this_thread::yield();
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * batch);
+}
+
+// Same as BM_Throughput with empty tasks, but every batch is submitted with
+// a single SubmitBatch() call. Arguments: {batch, workers}.
+template <class Kind> void BM_SubmitBatch(benchmark::State &state) {
+  const auto batch = static_cast<size_t>(state.range(0));
+
+  typename Kind::Store store;
+  auto pool = Kind::Make(store, static_cast<size_t>(state.range(1)));
+
+  std::atomic<int64_t> executed(0);
+  std::vector<std::function<void()>> funcs(batch, [&executed]() {
+    executed.fetch_add(1, std::memory_order_relaxed);
+  });
+  for (auto _ : state) {
+    store.SubmitBatch(funcs).get();
+  }
+
+  state.SetItemsProcessed(executed.load());
+}
+
+void ThroughputArgs(benchmark::internal::Benchmark *b) {
+  for (int64_t work_ns : {0, 1000, 100000}) {
+    for (int64_t workers : {1, 2, 4, 8}) {
+      b->Args({work_ns, workers});
+    }
+  }
+}
+
+} // namespace
+
+BENCHMARK(BM_SignalTreeAcquireRelease)
+    ->Arg(64)
+    ->Arg(1024)
+    ->Arg(16384)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+
+BENCHMARK_TEMPLATE(BM_SubmitToExecute, LockFreePool)
+    ->RangeMultiplier(2)
+    ->Range(1, 8)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_SubmitToExecute, SpscPool)
+    ->RangeMultiplier(2)
+    ->Range(1, 8)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_SubmitToExecute, MutexPool)
+    ->RangeMultiplier(2)
+    ->Range(1, 8)
+    ->UseRealTime();
+
+BENCHMARK_TEMPLATE(BM_Throughput, LockFreePool)
+    ->Apply(ThroughputArgs)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Throughput, SpscPool)
+    ->Apply(ThroughputArgs)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Throughput, MutexPool)
+    ->Apply(ThroughputArgs)
+    ->UseRealTime();
+
+BENCHMARK_TEMPLATE(BM_SubmitBatch, LockFreePool)
+    ->ArgsProduct({{16, 256}, {1, 4, 8}})
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_SubmitBatch, SpscPool)
+    ->ArgsProduct({{16, 256}, {1, 4, 8}})
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_SubmitBatch, MutexPool)
+    ->ArgsProduct({{16, 256}, {1, 4, 8}})
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
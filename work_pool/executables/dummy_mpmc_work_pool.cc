@@ -19,9 +19,10 @@ int main() {
   std::cout << "Main tid="
             << std::hash<std::thread::id>{}(std::this_thread::get_id()) << "\n";
 
-  auto future = task_store.SubmitAndGetFuture(&add, 2, 40);
-
-  std::cout << "2 + 40 = " << future.get() << '\n'; // blocking
+  // The continuation runs on the pool once the sum is there; only main waits.
+  task_store.Async(&add, 2, 40)
+      .Then([](int sum) { std::cout << "2 + 40 = " << sum << '\n'; })
+      .Get();
 
   task_store.Submit(
       [](std::string s) {
@@ -0,0 +1,446 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "work_pool/task.h"
+
+namespace work_pool {
+
+// Where continuations run: any store with an Enqueue(Task) method, or inline
+// on the thread that completes the future when empty.
+class Executor {
+public:
+  Executor() = default;
+
+  template <class Store> static Executor Of(Store &store) {
+    Executor executor;
+    executor.store_ = &store;
+    executor.enqueue_ = [](void *s, Task task) {
+      static_cast<Store *>(s)->Enqueue(std::move(task));
+    };
+    return executor;
+  }
+
+  // Enqueues `task`, or runs it right away for the inline executor.
+  void Run(Task task) const {
+    if (enqueue_ != nullptr) {
+      enqueue_(store_, std::move(task));
+    } else {
+      task();
+    }
+  }
+
+private:
+  void *store_ = nullptr;
+  void (*enqueue_)(void *, Task) = nullptr;
+};
+
+template <class T> class Future;
+template <class T> class Promise;
+
+namespace internal {
+
+// Value type stored for a Future<T>; void becomes std::monostate.
+template <class T>
+using StoredType = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+template <class T> class FutureState {
+public:
+  using Stored = StoredType<T>;
+
+  void SetValue(Stored value) { Complete(std::move(value), nullptr); }
+
+  void SetException(std::exception_ptr error) {
+    Complete(std::nullopt, std::move(error));
+  }
+
+  const bool IsReady() const { return ready_.load(std::memory_order_acquire); }
+
+  // Runs `continuation` on `executor` once the state is ready (right away if
+  // it already is).
+  void OnReady(Executor executor, Task continuation) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!ready_.load(std::memory_order_relaxed)) {
+        continuations_.emplace_back(executor, std::move(continuation));
+        return;
+      }
+    }
+    executor.Run(std::move(continuation));
+  }
+
+  void Wait() {
+    if (IsReady()) {
+      return;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    ready_cv_.wait(lock, [this] { return IsReady(); });
+  }
+
+  // Only valid once ready. Rethrows the stored exception.
+  Stored &Value() {
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+    return *value_;
+  }
+
+  const std::exception_ptr &Error() const { return error_; }
+
+  // Only valid once ready. True if the state was completed by Abandon(),
+  // directly or passed down from an abandoned source.
+  const bool Abandoned() const { return abandoned_; }
+
+  // Completes with std::future_errc::broken_promise unless the state is
+  // already ready. This usually happens while a store destroys its queued
+  // tasks, so continuations run inline rather than on their executor. On an
+  // exception they only pass it down the chain.
+  void Abandon() {
+    if (!IsReady()) {
+      Complete(std::nullopt,
+               std::make_exception_ptr(
+                   std::future_error(std::future_errc::broken_promise)),
+               /*abandon=*/true);
+    }
+  }
+
+  // Completes with the error of a source state. An error from an abandoned
+  // source is passed on the same way as Abandon() does, so the rest of the
+  // chain completes inline too instead of being queued on a store that may
+  // be going away.
+  void ForwardError(std::exception_ptr error, const bool abandoned) {
+    Complete(std::nullopt, std::move(error), abandoned);
+  }
+
+private:
+  void Complete(std::optional<Stored> value, std::exception_ptr error,
+                const bool abandon = false) {
+    std::vector<std::pair<Executor, Task>> continuations;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (ready_.load(std::memory_order_relaxed)) {
+        if (abandon) {
+          return;
+        }
+        throw std::runtime_error("Future already has a value!");
+      }
+      value_ = std::move(value);
+      error_ = std::move(error);
+      abandoned_ = abandon;
+      ready_.store(true, std::memory_order_release);
+      continuations.swap(continuations_);
+    }
+    ready_cv_.notify_all();
+    for (auto &[executor, continuation] : continuations) {
+      if (abandon) {
+        continuation();
+      } else {
+        executor.Run(std::move(continuation));
+      }
+    }
+  }
+
+  std::atomic<bool> ready_{false};
+  std::mutex mutex_;
+  std::condition_variable ready_cv_;
+  std::optional<Stored> value_;
+  std::exception_ptr error_;
+  bool abandoned_ = false;
+  std::vector<std::pair<Executor, Task>> continuations_;
+};
+
+// Calls func(value) (func() if the source future is void) and stores the
+// result in `state`.
+template <class Source, class T, class Func>
+void Fulfill(FutureState<T> &state, Func &func, StoredType<Source> &value) {
+  try {
+    if constexpr (std::is_void_v<T>) {
+      if constexpr (std::is_void_v<Source>) {
+        func();
+      } else {
+        func(std::move(value));
+      }
+      state.SetValue(std::monostate());
+    } else {
+      if constexpr (std::is_void_v<Source>) {
+        state.SetValue(func());
+      } else {
+        state.SetValue(func(std::move(value)));
+      }
+    }
+  } catch (...) {
+    state.SetException(std::current_exception());
+  }
+}
+
+template <class T>
+using WhenAllType = std::conditional_t<std::is_void_v<T>, void, std::vector<T>>;
+
+} // namespace internal
+
+// Write end of a Future.
+//
+// Like std::promise, a Promise destroyed without a value (e.g. inside a task
+// that was dropped before it ran) completes its future with a
+// std::future_error of std::future_errc::broken_promise.
+template <class T> class Promise {
+public:
+  Promise() : state_(std::make_shared<internal::FutureState<T>>()) {}
+
+  ~Promise() {
+    if (state_) {
+      state_->Abandon();
+    }
+  }
+
+  // Moved-from promises have no state and do nothing on destruction.
+  Promise(Promise &&) noexcept = default;
+  Promise &operator=(Promise &&other) noexcept {
+    if (this != &other) {
+      if (state_) {
+        state_->Abandon();
+      }
+      state_ = std::move(other.state_);
+    }
+    return *this;
+  }
+  Promise(const Promise &) = delete;
+  Promise &operator=(const Promise &) = delete;
+
+  // Continuations of the returned future run on `executor`.
+  Future<T> GetFuture(Executor executor = Executor()) {
+    return Future<T>(state_, executor);
+  }
+
+  template <class U = T>
+    requires(!std::is_void_v<U>)
+  void SetValue(U value) {
+    state_->SetValue(std::move(value));
+  }
+
+  template <class U = T>
+    requires std::is_void_v<U>
+  void SetValue() {
+    state_->SetValue(std::monostate());
+  }
+
+  void SetException(std::exception_ptr error) {
+    state_->SetException(std::move(error));
+  }
+
+private:
+  template <class> friend class Future;
+  template <class U>
+  friend Future<internal::WhenAllType<U>> WhenAll(std::vector<Future<U>>);
+  template <class U>
+  friend Future<std::pair<size_t, internal::StoredType<U>>>
+      WhenAny(std::vector<Future<U>>);
+
+  std::shared_ptr<internal::FutureState<T>> state_;
+};
+
+// Pool-native future.
+//
+// Unlike std::future, work can be chained with Then() instead of blocking a
+// thread in Get(). A continuation runs on the future's executor (the store it
+// was submitted to, see TaskStore::Async()) once the value is there. An
+// exception skips the continuations and is passed down the chain to Get().
+//
+// Like std::future, a Future is move-only and its value goes to exactly one
+// consumer: call one of Get(), Then(), WhenAll() or WhenAny() on it, once.
+template <class T> class Future {
+public:
+  using ValueType = T;
+
+  Future() = default;
+  Future(Future &&) = default;
+  Future &operator=(Future &&) = default;
+  Future(const Future &) = delete;
+  Future &operator=(const Future &) = delete;
+
+  const bool Valid() const { return state_ != nullptr; }
+
+  const bool IsReady() const { return state_->IsReady(); }
+
+  // Blocks until ready. Meant for the edges of a program, not for workers.
+  void Wait() const { state_->Wait(); }
+
+  // Blocks until ready, then returns the value or rethrows the exception.
+  T Get() {
+    state_->Wait();
+    if constexpr (std::is_void_v<T>) {
+      state_->Value();
+    } else {
+      return std::move(state_->Value());
+    }
+  }
+
+  // Returns a future for func(value) (func() for Future<void>), run on this
+  // future's executor.
+  template <class Func> auto Then(Func &&func) {
+    return Then(executor_, std::forward<Func>(func));
+  }
+
+  // Same as above, but runs `func` on `executor`.
+  template <class Func> auto Then(Executor executor, Func &&func) {
+    using Result = typename ResultOf<std::decay_t<Func>>::type;
+
+    // The promise travels with the continuation, so a continuation that is
+    // dropped without running breaks the next future.
+    Promise<Result> promise;
+    Future<Result> next = promise.GetFuture(executor);
+    state_->OnReady(
+        executor, Task([state = state_, promise = std::move(promise),
+                        func_ = std::forward<Func>(func)]() mutable {
+          if (state->Error()) {
+            promise.state_->ForwardError(state->Error(), state->Abandoned());
+          } else {
+            internal::Fulfill<T>(*promise.state_, func_, state->Value());
+          }
+        }));
+    return next;
+  }
+
+  const Executor &GetExecutor() const { return executor_; }
+
+private:
+  template <class> friend class Future;
+  template <class> friend class Promise;
+  template <class U>
+  friend Future<internal::WhenAllType<U>> WhenAll(std::vector<Future<U>>);
+  template <class U>
+  friend Future<std::pair<size_t, internal::StoredType<U>>>
+      WhenAny(std::vector<Future<U>>);
+
+  template <class Func> struct ResultOf {
+    using type = std::invoke_result_t<Func, T>;
+  };
+  template <class Func>
+    requires std::is_void_v<T>
+  struct ResultOf<Func> {
+    using type = std::invoke_result_t<Func>;
+  };
+
+  Future(std::shared_ptr<internal::FutureState<T>> state, Executor executor)
+      : state_(std::move(state)), executor_(executor) {}
+
+  std::shared_ptr<internal::FutureState<T>> state_;
+  Executor executor_;
+};
+
+// Returns a future that completes with every value, in order, once all of
+// `futures` did, or with the first exception once all of them completed.
+// Future<void> inputs give a Future<void>.
+template <class T>
+Future<internal::WhenAllType<T>> WhenAll(std::vector<Future<T>> futures) {
+  using Result = internal::WhenAllType<T>;
+  struct State {
+    explicit State(const size_t n) : remaining(n), values(n) {}
+    std::atomic<size_t> remaining;
+    std::vector<std::optional<internal::StoredType<T>>> values;
+    std::mutex error_mutex;
+    std::exception_ptr error;
+    bool abandoned = false;
+    Promise<Result> promise;
+
+    void Complete() {
+      if (error) {
+        promise.state_->ForwardError(error, abandoned);
+      } else if constexpr (std::is_void_v<T>) {
+        promise.SetValue();
+      } else {
+        Result all;
+        all.reserve(values.size());
+        for (auto &value : values) {
+          all.push_back(std::move(*value));
+        }
+        promise.SetValue(std::move(all));
+      }
+    }
+  };
+
+  auto state = std::make_shared<State>(futures.size());
+  Future<Result> all = state->promise.GetFuture(
+      futures.empty() ? Executor() : futures.front().executor_);
+  if (futures.empty()) {
+    state->Complete();
+    return all;
+  }
+
+  for (size_t i = 0; i < futures.size(); ++i) {
+    auto source = futures[i].state_;
+    // Only moves a value into place, so it runs inline.
+    source->OnReady(Executor(), Task([state, source, i]() {
+      if (source->Error()) {
+        std::lock_guard<std::mutex> lock(state->error_mutex);
+        if (!state->error) {
+          state->error = source->Error();
+        }
+        state->abandoned = state->abandoned || source->Abandoned();
+      } else {
+        state->values[i].emplace(std::move(source->Value()));
+      }
+      if (state->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        state->Complete();
+      }
+    }));
+  }
+  return all;
+}
+
+// Returns a future that completes with (index, value) of the first of
+// `futures` to complete, or with its exception. The value of a Future<void>
+// is std::monostate.
+template <class T>
+Future<std::pair<size_t, internal::StoredType<T>>>
+WhenAny(std::vector<Future<T>> futures) {
+  using Result = std::pair<size_t, internal::StoredType<T>>;
+  if (futures.empty()) {
+    throw std::runtime_error("WhenAny() called with no futures!");
+  }
+  struct State {
+    std::atomic<bool> done{false};
+    Promise<Result> promise;
+  };
+
+  auto state = std::make_shared<State>();
+  Future<Result> any =
+      state->promise.GetFuture(futures.front().executor_);
+  for (size_t i = 0; i < futures.size(); ++i) {
+    auto source = futures[i].state_;
+    source->OnReady(Executor(), Task([state, source, i]() {
+      if (state->done.exchange(true, std::memory_order_acq_rel)) {
+        return;
+      }
+      if (source->Error()) {
+        state->promise.state_->ForwardError(source->Error(),
+                                            source->Abandoned());
+      } else {
+        state->promise.SetValue(Result(i, std::move(source->Value())));
+      }
+    }));
+  }
+  return any;
+}
+
+// Returns a future that is ready with `value`.
+template <class T> Future<T> MakeReadyFuture(T value) {
+  Promise<T> promise;
+  promise.SetValue(std::move(value));
+  return promise.GetFuture();
+}
+
+} // namespace work_pool
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "work_pool/event_count.h"
+
+namespace work_pool {
+
+// Hints the CPU that the caller is busy-waiting.
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+// What an idle worker does before it goes to sleep: spin with CpuRelax() for
+// `spin_iterations` polls, then std::this_thread::yield() for
+// `yield_iterations` polls, then park. At most `max_spinning` workers spin or
+// yield at a time; the others park right away, so an idle pool stops using
+// CPU once the spin budget of a few workers runs out.
+struct IdlePolicy {
+  uint32_t spin_iterations = 1024;
+  uint32_t yield_iterations = 8;
+  uint32_t max_spinning = 2;
+};
+
+// Consumer-side idle state of a task store.
+//
+// Producers call NotifyOne() after publishing a task. While some consumer is
+// spinning it will pick the task up by itself, so no parked consumer is woken
+// for it. A spinner that finds work and was the last one spinning wakes a
+// parked consumer in its place, so a burst of tasks still fans out.
+class IdleState {
+public:
+  IdleState() = default;
+
+  // Returns false if `max_spinning` consumers are already spinning.
+  const bool TryStartSpinning(const uint32_t max_spinning) {
+    uint32_t spinning = spinning_.load(std::memory_order_relaxed);
+    do {
+      if (spinning >= max_spinning) {
+        return false;
+      }
+    } while (!spinning_.compare_exchange_weak(spinning, spinning + 1,
+                                              std::memory_order_seq_cst));
+    return true;
+  }
+
+  // Stops spinning. Wakes a parked consumer if the caller found work and was
+  // the last spinner.
+  void StopSpinning(const bool found_work) {
+    const bool last = spinning_.fetch_sub(1, std::memory_order_seq_cst) == 1;
+    if (found_work && last) {
+      event_.NotifyOne();
+    }
+  }
+
+  void NotifyOne() {
+    // Orders the published task before the spinner check; pairs with the
+    // seq_cst RMW in StopSpinning() which precedes the spinner's last poll.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (spinning_.load(std::memory_order_relaxed) == 0) {
+      event_.NotifyOne();
+    }
+  }
+
+  // Wakes enough parked consumers that, together with the spinning ones,
+  // `n` consumers are looking for work.
+  void NotifyMany(const uint32_t n) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const uint32_t spinning = spinning_.load(std::memory_order_relaxed);
+    if (n > spinning) {
+      event_.NotifyMany(n - spinning);
+    }
+  }
+
+  void NotifyAll() { event_.NotifyAll(); }
+
+  // Number of consumers spinning right now. Only a hint: it may change as
+  // soon as it is read.
+  const uint32_t Spinning() const {
+    return spinning_.load(std::memory_order_relaxed);
+  }
+
+  EventCount &Event() { return event_; }
+
+  IdleState(const IdleState &) = delete;
+  IdleState &operator=(const IdleState &) = delete;
+
+private:
+  alignas(64) std::atomic<uint32_t> spinning_{0};
+  EventCount event_;
+};
+
+} // namespace work_pool
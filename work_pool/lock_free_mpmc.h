@@ -1,42 +1,126 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 
 #include "blockingconcurrentqueue.h"
 #include "work_pool/task_store.h"
+#include "work_pool/thread_cache.h"
 
 namespace work_pool {
 
 // Multi-Producer Multi-Consumer Lock Free Queue.
 // Wrapper around moodycamel::BlockingConcurrentQueue.
+//
+// Every producer thread enqueues through its own moodycamel::ProducerToken.
+// Tokens are owned by the store and looked up through a per-thread cache of
+// the last few stores the thread used; a token goes back to the store when
+// its cache entry is evicted or its thread exits.
 class MPMCTaskStore : public TaskStore<MPMCTaskStore> {
 public:
   using Base = TaskStore<MPMCTaskStore>;
   using Task = typename Base::Task;
 
-  MPMCTaskStore() = default;
-  ~MPMCTaskStore() = default;
+  MPMCTaskStore()
+      : id_(next_id_.fetch_add(1, std::memory_order_relaxed)),
+        tokens_(std::make_shared<Tokens>()) {}
 
-  void EnqueueImpl(std::shared_ptr<Task> task) {
-    queue_.enqueue(std::move(task));
+  ~MPMCTaskStore() {
+    // Tokens must go before the queue does. Threads that still cache one
+    // only drop their reference to tokens_ later.
+    std::lock_guard<std::mutex> lock(tokens_->mutex);
+    tokens_->closed = true;
+    tokens_->owned.clear();
   }
 
-  void WaitDequeueImpl(std::shared_ptr<Task> &task) {
-    queue_.wait_dequeue(task);
+  void EnqueueImpl(Task task) { queue_.enqueue(LocalToken(), std::move(task)); }
+
+  void EnqueueBulkImpl(Task *tasks, const size_t count) {
+    queue_.enqueue_bulk(LocalToken(), std::make_move_iterator(tasks), count);
   }
 
+  bool TryDequeueImpl(Task &task) { return queue_.try_dequeue(task); }
+
+  size_t TryDequeueBulkImpl(Task *tasks, const size_t max) {
+    return queue_.try_dequeue_bulk(tasks, max);
+  }
+
+  size_t SizeApproxImpl() const { return queue_.size_approx(); }
+
+  void WaitDequeueImpl(Task &task) { queue_.wait_dequeue(task); }
+
   template <class Rep, class Period>
   bool
-  WaitDequeueTimedImpl(std::shared_ptr<Task> &task,
+  WaitDequeueTimedImpl(Task &task,
                        const std::chrono::duration<Rep, Period> &duration) {
     return queue_.wait_dequeue_timed(task, duration);
   }
 
+  // Producer tokens currently handed out to threads.
+  const size_t NumProducerTokens() const {
+    std::lock_guard<std::mutex> lock(tokens_->mutex);
+    return tokens_->owned.size();
+  }
+
   MPMCTaskStore(const MPMCTaskStore &) = delete;
   MPMCTaskStore &operator=(const MPMCTaskStore &) = delete;
 
 private:
-  moodycamel::BlockingConcurrentQueue<std::shared_ptr<Task>> queue_;
+  // Tokens of one store. Shared with the thread caches, so a thread that
+  // exits after the store was destroyed can still see that it was.
+  struct Tokens {
+    mutable std::mutex mutex;
+    bool closed = false;
+    std::unordered_map<moodycamel::ProducerToken *,
+                       std::unique_ptr<moodycamel::ProducerToken>>
+        owned;
+  };
+
+  // A thread's token for one store, returned to the store on destruction.
+  class TokenLease {
+  public:
+    TokenLease(std::shared_ptr<Tokens> tokens,
+               moodycamel::BlockingConcurrentQueue<Task> &queue)
+        : tokens_(std::move(tokens)) {
+      auto token = std::make_unique<moodycamel::ProducerToken>(queue);
+      token_ = token.get();
+      std::lock_guard<std::mutex> lock(tokens_->mutex);
+      tokens_->owned.emplace(token_, std::move(token));
+    }
+
+    ~TokenLease() {
+      std::lock_guard<std::mutex> lock(tokens_->mutex);
+      if (!tokens_->closed) {
+        tokens_->owned.erase(token_);
+      }
+    }
+
+    TokenLease(const TokenLease &) = delete;
+    TokenLease &operator=(const TokenLease &) = delete;
+
+    moodycamel::ProducerToken &Token() const { return *token_; }
+
+  private:
+    std::shared_ptr<Tokens> tokens_;
+    moodycamel::ProducerToken *token_;
+  };
+
+  moodycamel::ProducerToken &LocalToken() {
+    // Keyed by a process-unique id rather than `this`, so a store allocated
+    // where a destroyed one lived never sees the old token.
+    return ThreadCache<TokenLease>::Get(id_, tokens_, queue_).Token();
+  }
+
+  static inline std::atomic<uint64_t> next_id_{1};
+
+  const uint64_t id_;
+  moodycamel::BlockingConcurrentQueue<Task> queue_;
+  std::shared_ptr<Tokens> tokens_;
 };
 
 } // namespace work_pool
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "metrics/metrics.h"
+#include "work_pool/task_store.h"
+#include "work_pool/topology.h"
+
+namespace work_pool {
+
+// TaskStore with one `Inner` store per NUMA node.
+//
+// Tasks go to the store of the node the submitting thread runs on (see
+// Topology::CurrentNode()), or to an explicit node through OnNode(). A
+// consumer drains its own node first and only takes work from other nodes
+// once that is empty, so tasks mostly run next to the memory their producer
+// touched. Pair it with a ThreadPool placed with SetPlacement() so workers
+// know their node.
+template <class Inner>
+class NumaTaskStore : public TaskStore<NumaTaskStore<Inner>> {
+public:
+  using Base = TaskStore<NumaTaskStore<Inner>>;
+  using Task = typename Base::Task;
+
+  // View that submits every task to one node.
+  class Submitter : public TaskStore<Submitter> {
+  public:
+    void EnqueueImpl(Task task) {
+      store_.nodes_[node_]->EnqueueImpl(std::move(task));
+    }
+
+    void EnqueueBulkImpl(Task *tasks, const size_t count) {
+      store_.EnqueueBulkToNode(node_, tasks, count);
+    }
+
+    IdleState &Idle() { return store_.Idle(); }
+
+    // Continuations are not tied to the node.
+    Executor AsExecutor() { return store_.AsExecutor(); }
+
+  private:
+    friend class NumaTaskStore;
+
+    Submitter(NumaTaskStore &store, const size_t node)
+        : store_(store), node_(node) {}
+
+    NumaTaskStore &store_;
+    const size_t node_;
+  };
+
+  explicit NumaTaskStore(const Topology &topology) : topology_(topology) {
+    for (size_t i = 0; i < topology_.NumNodes(); ++i) {
+      nodes_.push_back(std::make_unique<Inner>());
+    }
+  }
+
+  ~NumaTaskStore() = default;
+
+  const Topology &GetTopology() const { return topology_; }
+
+  const size_t NumNodes() const { return nodes_.size(); }
+
+  // Returns a view whose Submit*/Enqueue calls go to `node`.
+  Submitter OnNode(const size_t node) {
+    if (node >= nodes_.size()) {
+      throw std::runtime_error("Invalid NUMA node!");
+    }
+    return Submitter(*this, node);
+  }
+
+  // Approximate number of tasks queued on `node`.
+  size_t SizeApproxOnNode(const size_t node) const {
+    return nodes_[node]->SizeApprox();
+  }
+
+  void EnqueueImpl(Task task) {
+    nodes_[LocalNode()]->EnqueueImpl(std::move(task));
+  }
+
+  void EnqueueBulkImpl(Task *tasks, const size_t count) {
+    EnqueueBulkToNode(LocalNode(), tasks, count);
+  }
+
+  bool TryDequeueImpl(Task &task) { return TryDequeueBulkImpl(&task, 1) == 1; }
+
+  size_t TryDequeueBulkImpl(Task *tasks, const size_t max) {
+    const size_t local = LocalNode();
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+      const size_t node = (local + i) % nodes_.size();
+      if (const size_t n = nodes_[node]->TryDequeueBulk(tasks, max)) {
+        if (node != local) {
+          LFWP_METRIC_COUNT("numa_task_store.remote_dequeues", n);
+        }
+        return n;
+      }
+    }
+    return 0;
+  }
+
+  size_t SizeApproxImpl() const {
+    size_t total = 0;
+    for (const auto &node : nodes_) {
+      total += node->SizeApprox();
+    }
+    return total;
+  }
+
+  void WaitDequeueImpl(Task &task) {
+    while (!WaitDequeueUntil(task,
+                             std::chrono::steady_clock::time_point::max())) {
+    }
+  }
+
+  template <class Rep, class Period>
+  bool
+  WaitDequeueTimedImpl(Task &task,
+                       const std::chrono::duration<Rep, Period> &duration) {
+    return WaitDequeueUntil(task, std::chrono::steady_clock::now() + duration);
+  }
+
+  NumaTaskStore(const NumaTaskStore &) = delete;
+  NumaTaskStore &operator=(const NumaTaskStore &) = delete;
+
+private:
+  // Like Inner::EnqueueBulk(), but without notifying the inner store, which
+  // nobody waits on.
+  void EnqueueBulkToNode(const size_t node, Task *tasks, const size_t count) {
+    Inner &inner = *nodes_[node];
+    if constexpr (requires { inner.EnqueueBulkImpl(tasks, count); }) {
+      inner.EnqueueBulkImpl(tasks, count);
+    } else {
+      for (size_t i = 0; i < count; ++i) {
+        inner.EnqueueImpl(std::move(tasks[i]));
+      }
+    }
+  }
+
+  size_t LocalNode() const {
+    return static_cast<size_t>(topology_.CurrentNode()) % nodes_.size();
+  }
+
+  bool WaitDequeueUntil(Task &task,
+                        const std::chrono::steady_clock::time_point deadline) {
+    // Every enqueue notifies Idle(), so blocking consumers park there too.
+    EventCount &event = this->Idle().Event();
+    while (true) {
+      if (TryDequeueImpl(task)) {
+        return true;
+      }
+      const EventCount::Key key = event.PrepareWait();
+      if (TryDequeueImpl(task)) {
+        event.CancelWait();
+        return true;
+      }
+      if (!event.WaitUntil(key, deadline)) {
+        return TryDequeueImpl(task);
+      }
+    }
+  }
+
+  const Topology topology_;
+  std::vector<std::unique_ptr<Inner>> nodes_;
+};
+
+} // namespace work_pool
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "work_pool/task.h"
+
+namespace work_pool {
+
+namespace internal {
+
+// Shared state of one parallel loop over [begin, end).
+//
+// Participants (the caller and up to one helper task per worker) claim chunks
+// from a shared cursor. A chunk is a fraction of what is left, but at least
+// `grain` items, so chunks start large and shrink towards the end where they
+// balance the load. Completion is a single counter of unfinished items.
+template <std::integral Index, class ChunkFunc> class LoopState {
+public:
+  LoopState(const Index begin, const Index end, const size_t grain,
+            const size_t participants, ChunkFunc *chunk_func)
+      : next_(begin), end_(end), grain_(grain),
+        participants_(participants), chunk_func_(chunk_func),
+        remaining_(static_cast<size_t>(end - begin)) {}
+
+  // Claims and runs chunks until the range is exhausted.
+  void Work() {
+    Index begin;
+    Index end;
+    while (Claim(begin, end)) {
+      if (!failed_.load(std::memory_order_relaxed)) {
+        try {
+          (*chunk_func_)(begin, end);
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(error_mutex_);
+          if (!error_) {
+            error_ = std::current_exception();
+          }
+          failed_.store(true, std::memory_order_relaxed);
+        }
+      }
+      Finish(static_cast<size_t>(end - begin));
+    }
+  }
+
+  // Blocks until every item has been processed, then rethrows the first
+  // exception thrown by the loop body, if any.
+  void Wait() {
+    size_t remaining;
+    while ((remaining = remaining_.load(std::memory_order_acquire)) != 0) {
+      remaining_.wait(remaining, std::memory_order_acquire);
+    }
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+  }
+
+private:
+  bool Claim(Index &begin, Index &end) {
+    Index current = next_.load(std::memory_order_relaxed);
+    while (current < end_) {
+      const size_t left = static_cast<size_t>(end_ - current);
+      const size_t chunk =
+          std::min(left, std::max(grain_, left / (2 * participants_)));
+      const Index stop = current + static_cast<Index>(chunk);
+      if (next_.compare_exchange_weak(current, stop,
+                                      std::memory_order_relaxed)) {
+        begin = current;
+        end = stop;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void Finish(const size_t count) {
+    if (remaining_.fetch_sub(count, std::memory_order_acq_rel) == count) {
+      remaining_.notify_all();
+    }
+  }
+
+  alignas(64) std::atomic<Index> next_;
+  const Index end_;
+  const size_t grain_;
+  const size_t participants_;
+  // Lives on the caller's stack: helpers only touch it after claiming a
+  // chunk, and the caller waits for every claimed chunk.
+  ChunkFunc *chunk_func_;
+
+  alignas(64) std::atomic<size_t> remaining_;
+  std::atomic<bool> failed_{false};
+  std::mutex error_mutex_;
+  std::exception_ptr error_;
+};
+
+// Runs chunk_func(chunk_begin, chunk_end) over [begin, end) on the pool's
+// workers and the calling thread, and returns once all chunks are done.
+template <class Pool, std::integral Index, class ChunkFunc>
+void RunChunks(Pool &pool, const Index begin, const Index end,
+               size_t grain, ChunkFunc &chunk_func) {
+  if (begin >= end) {
+    return;
+  }
+  grain = std::max<size_t>(grain, 1);
+  const size_t items = static_cast<size_t>(end - begin);
+  const size_t chunks = (items + grain - 1) / grain;
+  const size_t helpers = std::min(pool.NumThreads(), chunks - 1);
+
+  auto state = std::make_shared<LoopState<Index, ChunkFunc>>(
+      begin, end, grain, helpers + 1, &chunk_func);
+  if (helpers > 0) {
+    std::vector<Task> tasks;
+    tasks.reserve(helpers);
+    for (size_t i = 0; i < helpers; ++i) {
+      tasks.emplace_back([state]() { state->Work(); });
+    }
+    pool.Store().EnqueueBulk(tasks.data(), tasks.size());
+  }
+
+  // The caller works too, so this also makes progress when called from a
+  // worker of the same pool while every other worker is busy.
+  state->Work();
+  state->Wait();
+}
+
+} // namespace internal
+
+// Calls func(i) for every i in [begin, end).
+//
+// Iterations are split lazily into chunks of at least `grain` indices; raise
+// it when func(i) is very cheap. The first exception thrown by func is
+// rethrown here once every claimed chunk has finished.
+template <class Pool, std::integral Index, class Func>
+void ParallelFor(Pool &pool, const Index begin, const Index end, Func &&func,
+                 const size_t grain = 1) {
+  auto chunk_func = [&func](const Index chunk_begin, const Index chunk_end) {
+    for (Index i = chunk_begin; i < chunk_end; ++i) {
+      func(i);
+    }
+  };
+  internal::RunChunks(pool, begin, end, grain, chunk_func);
+}
+
+// Folds `range` with `op`, starting from `init`, and returns
+// op(...op(op(init, range[0]), range[1])..., range[n - 1]).
+//
+// `op` must be associative. It need not be commutative: chunk results are
+// combined in index order.
+template <class Pool, std::ranges::random_access_range Range, class T,
+          class Op>
+T ParallelReduce(Pool &pool, Range &&range, T init, Op op,
+                 const size_t grain = 1024) {
+  const auto first = std::ranges::begin(range);
+  const size_t size = static_cast<size_t>(std::ranges::size(range));
+
+  // (chunk begin, chunk result). Chunks are few, so a lock is fine here.
+  std::mutex partials_mutex;
+  std::vector<std::pair<size_t, T>> partials;
+  auto chunk_func = [&](const size_t chunk_begin, const size_t chunk_end) {
+    T partial = first[chunk_begin];
+    for (size_t i = chunk_begin + 1; i < chunk_end; ++i) {
+      partial = op(std::move(partial), first[i]);
+    }
+    std::lock_guard<std::mutex> lock(partials_mutex);
+    partials.emplace_back(chunk_begin, std::move(partial));
+  };
+  internal::RunChunks(pool, size_t{0}, size, grain, chunk_func);
+
+  std::sort(partials.begin(), partials.end(),
+            [](const auto &a, const auto &b) { return a.first < b.first; });
+  for (auto &partial : partials) {
+    init = op(std::move(init), std::move(partial.second));
+  }
+  return init;
+}
+
+// Inclusive scan: out[i] = op(...op(op(init, range[0]), range[1])...,
+// range[i]). `op` must be associative.
+//
+// Two passes over fixed blocks: the first reduces every block, the second
+// scans every block starting from the (sequential) prefix of the block sums.
+template <class Pool, std::ranges::random_access_range Range,
+          std::random_access_iterator OutputIt, class T, class Op>
+void ParallelScan(Pool &pool, Range &&range, OutputIt out, const T &init,
+                  Op op) {
+  const auto first = std::ranges::begin(range);
+  const size_t size = static_cast<size_t>(std::ranges::size(range));
+  if (size == 0) {
+    return;
+  }
+
+  // A few blocks per participant, so the block passes still balance.
+  const size_t num_blocks = std::min(size, 4 * (pool.NumThreads() + 1));
+  const size_t block_size = (size + num_blocks - 1) / num_blocks;
+  const auto block_begin = [&](const size_t block) {
+    return std::min(size, block * block_size);
+  };
+  const auto block_end = [&](const size_t block) {
+    return std::min(size, (block + 1) * block_size);
+  };
+
+  // Pass 1: reduce every block but the last.
+  std::vector<T> carry(num_blocks, init);
+  ParallelFor(pool, size_t{0}, num_blocks - 1, [&](const size_t block) {
+    const size_t begin = block_begin(block);
+    const size_t end = block_end(block);
+    if (begin == end) {
+      return;
+    }
+    T sum = first[begin];
+    for (size_t i = begin + 1; i < end; ++i) {
+      sum = op(std::move(sum), first[i]);
+    }
+    carry[block + 1] = std::move(sum);
+  });
+
+  // carry[b] becomes the value everything before block b folds into.
+  for (size_t block = 1; block < num_blocks; ++block) {
+    if (block_begin(block - 1) < block_end(block - 1)) {
+      carry[block] = op(carry[block - 1], std::move(carry[block]));
+    } else {
+      carry[block] = carry[block - 1];
+    }
+  }
+
+  // Pass 2: scan every block from its carry.
+  ParallelFor(pool, size_t{0}, num_blocks, [&](const size_t block) {
+    T acc = carry[block];
+    for (size_t i = block_begin(block); i < block_end(block); ++i) {
+      acc = op(std::move(acc), first[i]);
+      out[i] = acc;
+    }
+  });
+}
+
+} // namespace work_pool
@@ -0,0 +1,277 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "concurrentqueue.h"
+#include "lightweightsemaphore.h"
+#include "work_pool/task_store.h"
+
+namespace work_pool {
+
+enum class Priority { kHigh = 0, kNormal = 1, kLow = 2 };
+
+// Multi-level task store.
+//
+// Every priority class has its own lock-free queue. Tasks submitted with a
+// deadline go to an earliest-deadline-first lane instead, which is always
+// served before the classes. Between the classes, workers either drain
+// strictly by priority, or follow a weighted round robin so that low
+// priority work keeps making progress under a flood of high priority work.
+//
+// Plain Enqueue()/Submit() use Priority::kNormal; At() returns a view that
+// submits with a given class and deadline:
+//
+//   store.At(Priority::kHigh).SubmitAndGetFuture(...);
+//   store.At(Priority::kLow, deadline).Submit(...);
+class PriorityTaskStore : public TaskStore<PriorityTaskStore> {
+public:
+  using Base = TaskStore<PriorityTaskStore>;
+  using Task = typename Base::Task;
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr size_t kNumPriorities = 3;
+
+  enum class Drain {
+    // Always take from the highest non-empty class.
+    kStrict,
+    // Out of every sum(weights) dequeues, class i is tried first weights[i]
+    // times, falling back to the other classes in priority order.
+    kWeighted,
+  };
+
+  // Per-class counters. Wait time is measured from enqueue to dequeue.
+  struct Stats {
+    int64_t depth = 0;
+    uint64_t dequeued = 0;
+    uint64_t total_wait_ns = 0;
+    uint64_t max_wait_ns = 0;
+  };
+
+  // Submits into a PriorityTaskStore with a fixed class and deadline.
+  class Submitter : public TaskStore<Submitter> {
+  public:
+    // TaskStore::Enqueue() of this view wakes the consumer.
+    void EnqueueImpl(Task task) {
+      store_.Push(priority_, deadline_, std::move(task));
+    }
+
+    IdleState &Idle() { return store_.Idle(); }
+
+    // Continuations run at the store's default class.
+    Executor AsExecutor() { return store_.AsExecutor(); }
+
+  private:
+    friend class PriorityTaskStore;
+
+    Submitter(PriorityTaskStore &store, const Priority priority,
+              const std::optional<Clock::time_point> deadline)
+        : store_(store), priority_(priority), deadline_(deadline) {}
+
+    PriorityTaskStore &store_;
+    const Priority priority_;
+    const std::optional<Clock::time_point> deadline_;
+  };
+
+  explicit PriorityTaskStore(
+      const Drain drain = Drain::kStrict,
+      const std::array<uint32_t, kNumPriorities> &weights = {8, 4, 1})
+      : drain_(drain) {
+    for (size_t i = 0; i < kNumPriorities; ++i) {
+      for (uint32_t w = 0; w < std::max<uint32_t>(weights[i], 1); ++w) {
+        schedule_.push_back(static_cast<uint8_t>(i));
+      }
+    }
+  }
+
+  ~PriorityTaskStore() = default;
+
+  // Returns a view whose Submit*/Enqueue calls use `priority` and, if set,
+  // put the task in the deadline lane.
+  Submitter At(const Priority priority,
+               const std::optional<Clock::time_point> deadline =
+                   std::nullopt) {
+    return Submitter(*this, priority, deadline);
+  }
+
+  void EnqueueImpl(Task task) {
+    Push(Priority::kNormal, std::nullopt, std::move(task));
+  }
+
+  // Enqueues with an explicit class and deadline, and wakes a consumer.
+  void EnqueueWith(const Priority priority,
+                   const std::optional<Clock::time_point> deadline,
+                   Task task) {
+    Push(priority, deadline, std::move(task));
+    Idle().NotifyOne();
+  }
+
+  bool TryDequeueImpl(Task &task) {
+    if (!ready_.tryWait()) {
+      return false;
+    }
+    Take(task);
+    return true;
+  }
+
+  void WaitDequeueImpl(Task &task) {
+    ready_.wait();
+    Take(task);
+  }
+
+  template <class Rep, class Period>
+  bool
+  WaitDequeueTimedImpl(Task &task,
+                       const std::chrono::duration<Rep, Period> &duration) {
+    if (!ready_.wait(std::chrono::duration_cast<std::chrono::microseconds>(
+                         duration)
+                         .count())) {
+      return false;
+    }
+    Take(task);
+    return true;
+  }
+
+  size_t SizeApproxImpl() const { return ready_.availableApprox(); }
+
+  // Snapshot of the counters of one class (deadline tasks included).
+  const Stats GetStats(const Priority priority) const {
+    const ClassCounters &c = counters_[static_cast<size_t>(priority)];
+    Stats stats;
+    const uint64_t enqueued = c.enqueued.load(std::memory_order_relaxed);
+    stats.dequeued = c.dequeued.load(std::memory_order_relaxed);
+    stats.depth = static_cast<int64_t>(enqueued - stats.dequeued);
+    stats.total_wait_ns = c.total_wait_ns.load(std::memory_order_relaxed);
+    stats.max_wait_ns = c.max_wait_ns.load(std::memory_order_relaxed);
+    return stats;
+  }
+
+  PriorityTaskStore(const PriorityTaskStore &) = delete;
+  PriorityTaskStore &operator=(const PriorityTaskStore &) = delete;
+
+private:
+  struct Entry {
+    Task task;
+    Clock::time_point enqueued;
+    Priority priority = Priority::kNormal;
+  };
+
+  struct DeadlineEntry {
+    Clock::time_point deadline;
+    // Keeps tasks with equal deadlines in FIFO order.
+    uint64_t seq;
+    Entry entry;
+  };
+
+  struct alignas(64) ClassCounters {
+    std::atomic<uint64_t> enqueued{0};
+    std::atomic<uint64_t> dequeued{0};
+    std::atomic<uint64_t> total_wait_ns{0};
+    std::atomic<uint64_t> max_wait_ns{0};
+  };
+
+  void Push(const Priority priority,
+            const std::optional<Clock::time_point> deadline, Task task) {
+    const size_t cls = static_cast<size_t>(priority);
+    counters_[cls].enqueued.fetch_add(1, std::memory_order_relaxed);
+    Entry entry{std::move(task), Clock::now(), priority};
+    if (deadline) {
+      std::lock_guard<std::mutex> lock(deadline_mutex_);
+      deadlines_.push_back(
+          DeadlineEntry{*deadline, deadline_seq_++, std::move(entry)});
+      std::push_heap(deadlines_.begin(), deadlines_.end(), Later);
+      deadline_count_.fetch_add(1, std::memory_order_release);
+    } else {
+      queues_[cls].enqueue(std::move(entry));
+    }
+    ready_.signal();
+  }
+
+  // Called after taking a unit from `ready_`, so an entry exists in some
+  // lane; it may still be in flight, hence the loop.
+  void Take(Task &task) {
+    Entry entry;
+    while (!TakeDeadline(entry) && !TakeClass(entry)) {
+    }
+    Record(entry);
+    task = std::move(entry.task);
+  }
+
+  bool TakeDeadline(Entry &entry) {
+    if (deadline_count_.load(std::memory_order_acquire) == 0) {
+      return false;
+    }
+    std::lock_guard<std::mutex> lock(deadline_mutex_);
+    if (deadlines_.empty()) {
+      return false;
+    }
+    std::pop_heap(deadlines_.begin(), deadlines_.end(), Later);
+    entry = std::move(deadlines_.back().entry);
+    deadlines_.pop_back();
+    deadline_count_.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  bool TakeClass(Entry &entry) {
+    size_t first = 0;
+    if (drain_ == Drain::kWeighted) {
+      const uint64_t ticket = ticket_.fetch_add(1, std::memory_order_relaxed);
+      first = schedule_[ticket % schedule_.size()];
+      if (queues_[first].try_dequeue(entry)) {
+        return true;
+      }
+    }
+    for (size_t cls = 0; cls < kNumPriorities; ++cls) {
+      if (cls != first || drain_ == Drain::kStrict) {
+        if (queues_[cls].try_dequeue(entry)) {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  void Record(const Entry &entry) {
+    ClassCounters &c = counters_[static_cast<size_t>(entry.priority)];
+    const uint64_t wait_ns = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                             entry.enqueued)
+            .count());
+    c.dequeued.fetch_add(1, std::memory_order_relaxed);
+    c.total_wait_ns.fetch_add(wait_ns, std::memory_order_relaxed);
+    uint64_t max = c.max_wait_ns.load(std::memory_order_relaxed);
+    while (wait_ns > max && !c.max_wait_ns.compare_exchange_weak(
+                                max, wait_ns, std::memory_order_relaxed)) {
+    }
+  }
+
+  // Heap comparator: the earliest deadline ends up on top.
+  static bool Later(const DeadlineEntry &a, const DeadlineEntry &b) {
+    return a.deadline != b.deadline ? a.deadline > b.deadline : a.seq > b.seq;
+  }
+
+  const Drain drain_;
+  // Class to try first for each weighted round robin ticket.
+  std::vector<uint8_t> schedule_;
+  alignas(64) std::atomic<uint64_t> ticket_{0};
+
+  std::array<moodycamel::ConcurrentQueue<Entry>, kNumPriorities> queues_;
+
+  alignas(64) std::atomic<size_t> deadline_count_{0};
+  std::mutex deadline_mutex_;
+  std::vector<DeadlineEntry> deadlines_;
+  uint64_t deadline_seq_ = 0;
+
+  // One unit per queued task, across all lanes.
+  moodycamel::LightweightSemaphore ready_;
+
+  std::array<ClassCounters, kNumPriorities> counters_;
+};
+
+} // namespace work_pool
@@ -0,0 +1,307 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+#include "concurrentqueue.h"
+#include "metrics/metrics.h"
+#include "work_pool/task_store.h"
+#include "work_pool/thread_cache.h"
+
+namespace work_pool {
+
+// Bounded single-producer single-consumer ring of tasks (Lamport queue with
+// cached indices). Each side keeps a stale copy of the other side's index,
+// so a push or pop only reads the other side's cache line when its copy
+// says the ring is full or empty.
+class SpscRing {
+public:
+  // `capacity` must be a power of two.
+  explicit SpscRing(const size_t capacity)
+      : mask_(capacity - 1), cells_(new Task[capacity]) {}
+
+  // Producer side.
+  bool TryPush(Task &task) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_cache_ > mask_) {
+      head_cache_ = head_.load(std::memory_order_acquire);
+      if (tail - head_cache_ > mask_) {
+        return false;
+      }
+    }
+    cells_[tail & mask_] = std::move(task);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Pops up to `max` tasks and returns how many.
+  size_t TryPopBulk(Task *tasks, const size_t max) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (tail_cache_ == head) {
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+    }
+    const size_t n = std::min(max, tail_cache_ - head);
+    for (size_t i = 0; i < n; ++i) {
+      tasks[i] = std::move(cells_[(head + i) & mask_]);
+    }
+    if (n > 0) {
+      head_.store(head + n, std::memory_order_release);
+    }
+    return n;
+  }
+
+  // Either side, or anyone as a hint.
+  bool EmptyApprox() const { return SizeApprox() == 0; }
+
+  size_t SizeApprox() const {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    return tail > head ? tail - head : 0;
+  }
+
+  SpscRing(const SpscRing &) = delete;
+  SpscRing &operator=(const SpscRing &) = delete;
+
+private:
+  const size_t mask_;
+  std::unique_ptr<Task[]> cells_;
+  // Consumer line: its index and its copy of the producer's.
+  alignas(64) std::atomic<size_t> head_{0};
+  size_t tail_cache_ = 0;
+  // Producer line.
+  alignas(64) std::atomic<size_t> tail_{0};
+  size_t head_cache_ = 0;
+};
+
+// TaskStore made of per-producer SPSC lanes.
+//
+// Every producer thread is assigned a lane (round-robin, so with no more
+// producers than lanes each one gets its own) and pushes into its ring
+// without any read-modify-write on a shared line. Consumers scan the lanes
+// round-robin from a per-thread cursor and pop in bulk. Each side of a lane
+// is guarded by a try-lock, so lanes stay correct when threads share them;
+// a producer that finds its lane taken or full falls back to an MPMC
+// overflow queue instead of waiting.
+//
+// While some consumer is spinning, Enqueue() first offers the task in a
+// one-task handoff slot that consumers check before the lanes, so a task
+// goes straight to an idle worker without touching a queue.
+class SpscTaskStore : public TaskStore<SpscTaskStore> {
+public:
+  using Base = TaskStore<SpscTaskStore>;
+  using Task = typename Base::Task;
+
+  struct Options {
+    // Producer lanes.
+    size_t num_lanes = std::max(1u, std::thread::hardware_concurrency());
+    // Tasks per lane, rounded up to a power of two.
+    size_t lane_capacity = 256;
+  };
+
+  SpscTaskStore() : SpscTaskStore(Options()) {}
+
+  explicit SpscTaskStore(const Options &options)
+      : id_(next_id_.fetch_add(1, std::memory_order_relaxed)),
+        num_lanes_(options.num_lanes) {
+    if (options.num_lanes == 0 || options.lane_capacity == 0) {
+      throw std::runtime_error("SpscTaskStore needs lanes of capacity > 0!");
+    }
+    size_t capacity = 1;
+    while (capacity < options.lane_capacity) {
+      capacity <<= 1;
+    }
+    lanes_.reset(new std::unique_ptr<Lane>[num_lanes_]);
+    for (size_t i = 0; i < num_lanes_; ++i) {
+      lanes_[i] = std::make_unique<Lane>(capacity);
+    }
+  }
+
+  ~SpscTaskStore() = default;
+
+  const size_t NumLanes() const { return num_lanes_; }
+
+  void EnqueueImpl(Task task) {
+    if (Idle().Spinning() > 0 && TryHandOff(task)) {
+      LFWP_METRIC_COUNT("spsc_task_store.handoffs", 1);
+      return;
+    }
+    Lane &lane = *lanes_[LocalLane()];
+    if (!lane.producer_busy.exchange(true, std::memory_order_acquire)) {
+      const bool pushed = lane.ring.TryPush(task);
+      lane.producer_busy.store(false, std::memory_order_release);
+      if (pushed) {
+        return;
+      }
+    }
+    LFWP_METRIC_COUNT("spsc_task_store.overflows", 1);
+    overflow_.enqueue(std::move(task));
+  }
+
+  void EnqueueBulkImpl(Task *tasks, const size_t count) {
+    size_t pushed = 0;
+    Lane &lane = *lanes_[LocalLane()];
+    if (!lane.producer_busy.exchange(true, std::memory_order_acquire)) {
+      while (pushed < count && lane.ring.TryPush(tasks[pushed])) {
+        ++pushed;
+      }
+      lane.producer_busy.store(false, std::memory_order_release);
+    }
+    if (pushed < count) {
+      LFWP_METRIC_COUNT("spsc_task_store.overflows", count - pushed);
+      overflow_.enqueue_bulk(std::make_move_iterator(tasks + pushed),
+                             count - pushed);
+    }
+  }
+
+  bool TryDequeueImpl(Task &task) { return TryDequeueBulkImpl(&task, 1) == 1; }
+
+  size_t TryDequeueBulkImpl(Task *tasks, const size_t max) {
+    if (max == 0) {
+      return 0;
+    }
+    if (TryTakeHandOff(tasks[0])) {
+      return 1;
+    }
+    thread_local size_t cursor = 0;
+    const size_t start = cursor++;
+    // Lanes that never run dry would starve the overflow queue, so every
+    // kOverflowInterval-th dequeue of a thread looks there first.
+    if ((start + 1) % kOverflowInterval == 0 &&
+        overflow_.size_approx() > 0) {
+      const size_t n = overflow_.try_dequeue_bulk(tasks, max);
+      if (n > 0) {
+        return n;
+      }
+    }
+    for (size_t i = 0; i < num_lanes_; ++i) {
+      Lane &lane = *lanes_[(start + i) % num_lanes_];
+      if (lane.ring.EmptyApprox() ||
+          lane.consumer_busy.exchange(true, std::memory_order_acquire)) {
+        continue;
+      }
+      const size_t n = lane.ring.TryPopBulk(tasks, max);
+      lane.consumer_busy.store(false, std::memory_order_release);
+      if (n > 0) {
+        return n;
+      }
+    }
+    return overflow_.try_dequeue_bulk(tasks, max);
+  }
+
+  size_t SizeApproxImpl() const {
+    size_t size = overflow_.size_approx();
+    for (size_t i = 0; i < num_lanes_; ++i) {
+      size += lanes_[i]->ring.SizeApprox();
+    }
+    if (handoff_state_.load(std::memory_order_relaxed) == kFull) {
+      ++size;
+    }
+    return size;
+  }
+
+  void WaitDequeueImpl(Task &task) {
+    while (!WaitDequeueUntil(task,
+                             std::chrono::steady_clock::time_point::max())) {
+    }
+  }
+
+  template <class Rep, class Period>
+  bool
+  WaitDequeueTimedImpl(Task &task,
+                       const std::chrono::duration<Rep, Period> &duration) {
+    return WaitDequeueUntil(task, std::chrono::steady_clock::now() + duration);
+  }
+
+  SpscTaskStore(const SpscTaskStore &) = delete;
+  SpscTaskStore &operator=(const SpscTaskStore &) = delete;
+
+private:
+  enum HandOffState : uint32_t { kEmpty, kBusy, kFull };
+
+  // Dequeues between two checks of the overflow queue ahead of the lanes.
+  // Prime, so the check does not fall into step with the lane cursor.
+  static constexpr size_t kOverflowInterval = 61;
+
+  struct Lane {
+    explicit Lane(const size_t capacity) : ring(capacity) {}
+
+    SpscRing ring;
+    alignas(64) std::atomic<bool> producer_busy{false};
+    alignas(64) std::atomic<bool> consumer_busy{false};
+  };
+
+  // Lane of a producer thread, assigned round-robin on its first enqueue.
+  struct LaneIndex {
+    LaneIndex(std::atomic<size_t> &next_lane, const size_t num_lanes)
+        : lane(next_lane.fetch_add(1, std::memory_order_relaxed) % num_lanes) {
+    }
+
+    const size_t lane;
+  };
+
+  size_t LocalLane() {
+    // Keyed by a process-unique id rather than `this`, like
+    // MPMCTaskStore::LocalToken().
+    return ThreadCache<LaneIndex>::Get(id_, next_lane_, num_lanes_).lane;
+  }
+
+  bool TryHandOff(Task &task) {
+    uint32_t state = kEmpty;
+    if (!handoff_state_.compare_exchange_strong(state, kBusy,
+                                                std::memory_order_acquire)) {
+      return false;
+    }
+    handoff_ = std::move(task);
+    handoff_state_.store(kFull, std::memory_order_release);
+    return true;
+  }
+
+  bool TryTakeHandOff(Task &task) {
+    uint32_t state = kFull;
+    if (handoff_state_.load(std::memory_order_relaxed) != kFull ||
+        !handoff_state_.compare_exchange_strong(state, kBusy,
+                                                std::memory_order_acquire)) {
+      return false;
+    }
+    task = std::move(handoff_);
+    handoff_state_.store(kEmpty, std::memory_order_release);
+    return true;
+  }
+
+  bool WaitDequeueUntil(Task &task,
+                        const std::chrono::steady_clock::time_point deadline) {
+    // Every enqueue notifies Idle(), so blocking consumers park there too.
+    EventCount &event = Idle().Event();
+    while (true) {
+      if (TryDequeueImpl(task)) {
+        return true;
+      }
+      const EventCount::Key key = event.PrepareWait();
+      if (TryDequeueImpl(task)) {
+        event.CancelWait();
+        return true;
+      }
+      if (!event.WaitUntil(key, deadline)) {
+        return TryDequeueImpl(task);
+      }
+    }
+  }
+
+  static inline std::atomic<uint64_t> next_id_{1};
+
+  const uint64_t id_;
+  const size_t num_lanes_;
+  std::unique_ptr<std::unique_ptr<Lane>[]> lanes_;
+  alignas(64) std::atomic<size_t> next_lane_{0};
+  alignas(64) std::atomic<uint32_t> handoff_state_{kEmpty};
+  Task handoff_;
+  moodycamel::ConcurrentQueue<Task> overflow_;
+};
+
+} // namespace work_pool
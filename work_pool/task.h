@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#ifdef LFWP_ENABLE_METRICS
+#include "metrics/metrics.h"
+#endif
+
+namespace work_pool {
+
+// Move-only, type-erased nullary callable.
+//
+// Callables of up to kInlineSize bytes (e.g. a function pointer, its
+// arguments and a std::promise) are stored in place, so a task is exactly one
+// cache line and queues carry it by value without allocating. Larger or
+// over-aligned callables fall back to a heap allocation.
+class Task {
+public:
+  static constexpr size_t kInlineSize = 48;
+
+  Task() noexcept = default;
+
+  template <typename FuncType>
+    requires(!std::is_same_v<std::remove_cvref_t<FuncType>, Task>)
+  explicit Task(FuncType &&func) {
+    using F = std::decay_t<FuncType>;
+    if constexpr (kFitsInline<F>) {
+      ::new (static_cast<void *>(storage_)) F(std::forward<FuncType>(func));
+      ops_ = &kInlineOps<F>;
+    } else {
+      F *heap = new F(std::forward<FuncType>(func));
+      ::new (static_cast<void *>(storage_)) F *(heap);
+      ops_ = &kHeapOps<F>;
+    }
+  }
+
+  Task(Task &&other) noexcept { MoveFrom(other); }
+
+  Task &operator=(Task &&other) noexcept {
+    if (this != &other) {
+      Reset();
+      MoveFrom(other);
+    }
+    return *this;
+  }
+
+  ~Task() { Reset(); }
+
+  // True if the task holds a callable.
+  explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+  // Runs the callable. The callable stays alive until Reset() or destruction.
+  void operator()() { ops_->invoke(storage_); }
+
+  // Destroys the callable (and everything it captured).
+  void Reset() noexcept {
+    if (ops_ != nullptr) {
+      ops_->destroy(storage_);
+      ops_ = nullptr;
+    }
+  }
+
+  // True if the callable lives in the inline buffer.
+  bool IsInline() const noexcept { return ops_ != nullptr && ops_->is_inline; }
+
+#ifdef LFWP_ENABLE_METRICS
+  // Records when the task was enqueued (metrics::NowNs()), so consumers can
+  // measure its wait. Only in metrics builds; it fills the padding at the
+  // end of the task.
+  void StampEnqueue() noexcept { enqueue_ns_ = metrics::NowNs(); }
+  uint64_t EnqueueNs() const noexcept { return enqueue_ns_; }
+#endif
+
+  Task(const Task &) = delete;
+  Task &operator=(const Task &) = delete;
+
+private:
+  struct Ops {
+    void (*invoke)(void *storage);
+    // Move-constructs the callable from `src` into `dst` and destroys `src`.
+    void (*relocate)(void *dst, void *src) noexcept;
+    void (*destroy)(void *storage) noexcept;
+    bool is_inline;
+  };
+
+  template <typename F>
+  static constexpr bool kFitsInline =
+      sizeof(F) <= kInlineSize && alignof(F) <= alignof(std::max_align_t) &&
+      std::is_nothrow_move_constructible_v<F>;
+
+  template <typename F> static F *Inline(void *storage) noexcept {
+    return std::launder(static_cast<F *>(storage));
+  }
+  template <typename F> static F *Heap(void *storage) noexcept {
+    return *std::launder(static_cast<F **>(storage));
+  }
+
+  template <typename F>
+  static constexpr Ops kInlineOps{
+      [](void *storage) { (*Inline<F>(storage))(); },
+      [](void *dst, void *src) noexcept {
+        ::new (dst) F(std::move(*Inline<F>(src)));
+        Inline<F>(src)->~F();
+      },
+      [](void *storage) noexcept { Inline<F>(storage)->~F(); },
+      true,
+  };
+
+  template <typename F>
+  static constexpr Ops kHeapOps{
+      [](void *storage) { (*Heap<F>(storage))(); },
+      [](void *dst, void *src) noexcept { ::new (dst) F *(Heap<F>(src)); },
+      [](void *storage) noexcept { delete Heap<F>(storage); },
+      false,
+  };
+
+  void MoveFrom(Task &other) noexcept {
+    if (other.ops_ != nullptr) {
+      other.ops_->relocate(storage_, other.storage_);
+      ops_ = other.ops_;
+      other.ops_ = nullptr;
+    }
+#ifdef LFWP_ENABLE_METRICS
+    enqueue_ns_ = other.enqueue_ns_;
+#endif
+  }
+
+  alignas(std::max_align_t) unsigned char storage_[kInlineSize];
+  const Ops *ops_ = nullptr;
+#ifdef LFWP_ENABLE_METRICS
+  uint64_t enqueue_ns_ = 0;
+#endif
+};
+
+static_assert(sizeof(Task) == 64, "Task should fill exactly one cache line");
+
+} // namespace work_pool
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "work_pool/future.h"
+#include "work_pool/task.h"
+
+namespace work_pool {
+
+// Dependency graph of tasks.
+//
+// Nodes are added with Add() and ordered with Precede(). Run() submits every
+// node to a store the moment its last predecessor finishes, tracked with one
+// atomic counter per node, so no thread ever waits for a stage. If a node
+// throws, its successors are skipped and the first exception completes the
+// future returned by Run().
+//
+//   TaskGraph graph;
+//   auto load = graph.Add(...);
+//   auto parse = graph.Add(...);
+//   graph.Precede(load, parse);
+//   graph.Run(store).Then(...);
+class TaskGraph {
+public:
+  using NodeId = size_t;
+
+  TaskGraph() = default;
+
+  NodeId Add(std::function<void()> func) {
+    nodes_.push_back(Node{std::move(func), {}, 0});
+    return nodes_.size() - 1;
+  }
+
+  // `before` must finish before `after` starts.
+  void Precede(const NodeId before, const NodeId after) {
+    if (before >= nodes_.size() || after >= nodes_.size()) {
+      throw std::runtime_error("Precede() called with invalid node!");
+    }
+    nodes_[before].successors.push_back(after);
+    ++nodes_[after].predecessors;
+  }
+
+  const size_t Size() const { return nodes_.size(); }
+
+  // Runs the graph on `store`. The graph is copied, so it can be changed,
+  // run again or destroyed while this run is in flight. Throws if the graph
+  // has a cycle.
+  template <class Store> Future<void> Run(Store &store) {
+    CheckAcyclic();
+    auto run = std::make_shared<RunState>(store.AsExecutor(), nodes_);
+    Future<void> done = run->promise.GetFuture(run->executor);
+    if (nodes_.empty()) {
+      run->promise.SetValue();
+      return done;
+    }
+    for (NodeId id = 0; id < nodes_.size(); ++id) {
+      if (nodes_[id].predecessors == 0) {
+        Schedule(run, id);
+      }
+    }
+    return done;
+  }
+
+private:
+  struct Node {
+    std::function<void()> func;
+    std::vector<NodeId> successors;
+    size_t predecessors;
+  };
+
+  struct RunState {
+    RunState(Executor executor, std::vector<Node> nodes)
+        : executor(executor), nodes(std::move(nodes)),
+          pending(this->nodes.size()), remaining(this->nodes.size()) {
+      for (size_t i = 0; i < this->nodes.size(); ++i) {
+        pending[i].store(this->nodes[i].predecessors,
+                         std::memory_order_relaxed);
+      }
+    }
+
+    const Executor executor;
+    const std::vector<Node> nodes;
+    // Unfinished predecessors per node.
+    std::vector<std::atomic<size_t>> pending;
+    std::atomic<size_t> remaining;
+    std::atomic<bool> failed{false};
+    std::mutex error_mutex;
+    std::exception_ptr error;
+    Promise<void> promise;
+  };
+
+  static void Schedule(const std::shared_ptr<RunState> &run, const NodeId id) {
+    run->executor.Run(Task([run, id]() { Execute(run, id); }));
+  }
+
+  static void Execute(const std::shared_ptr<RunState> &run, const NodeId id) {
+    const Node &node = run->nodes[id];
+    if (!run->failed.load(std::memory_order_relaxed) && node.func) {
+      try {
+        node.func();
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(run->error_mutex);
+        if (!run->error) {
+          run->error = std::current_exception();
+        }
+        run->failed.store(true, std::memory_order_relaxed);
+      }
+    }
+
+    for (const NodeId successor : node.successors) {
+      if (run->pending[successor].fetch_sub(1, std::memory_order_acq_rel) ==
+          1) {
+        Schedule(run, successor);
+      }
+    }
+
+    if (run->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      if (run->error) {
+        run->promise.SetException(run->error);
+      } else {
+        run->promise.SetValue();
+      }
+    }
+  }
+
+  // Kahn's algorithm.
+  void CheckAcyclic() const {
+    std::vector<size_t> indegree(nodes_.size());
+    std::vector<NodeId> ready;
+    for (NodeId id = 0; id < nodes_.size(); ++id) {
+      indegree[id] = nodes_[id].predecessors;
+      if (indegree[id] == 0) {
+        ready.push_back(id);
+      }
+    }
+    size_t visited = 0;
+    while (!ready.empty()) {
+      const NodeId id = ready.back();
+      ready.pop_back();
+      ++visited;
+      for (const NodeId successor : nodes_[id].successors) {
+        if (--indegree[successor] == 0) {
+          ready.push_back(successor);
+        }
+      }
+    }
+    if (visited != nodes_.size()) {
+      throw std::runtime_error("TaskGraph has a cycle!");
+    }
+  }
+
+  std::vector<Node> nodes_;
+};
+
+} // namespace work_pool
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <type_traits>
+#include <utility>
+
+#include "concurrentqueue.h"
+#include "metrics/metrics.h"
+#include "work_pool/future.h"
+#include "work_pool/task.h"
+
+namespace work_pool {
+
+// Set of tasks that can be cancelled and waited for together.
+//
+// Members are kept in the group's own queue. Every Submit() also enqueues a
+// one-pointer trampoline on the store, which runs whichever member is next in
+// the group queue once a consumer dequeues it. Cancel() therefore drops every
+// member that has not started by draining the group queue; the trampolines
+// left in the store find it empty and return. Members already running see
+// the cancellation through their std::stop_token.
+//
+//   TaskGroup group(store);
+//   for (auto &part : request.parts) {
+//     group.Submit([&part](std::stop_token token) { Process(part, token); });
+//   }
+//   ...
+//   if (client_disconnected) {
+//     group.Cancel();
+//   }
+//   group.Wait();
+//
+// Trampolines hold a reference to the group state, so the group may be
+// destroyed while some of them are still queued. The destructor waits for
+// members that already started.
+class TaskGroup {
+public:
+  template <class Store>
+  explicit TaskGroup(Store &store)
+      : executor_(store.AsExecutor()), state_(std::make_shared<State>()) {}
+
+  ~TaskGroup() {
+    try {
+      Wait();
+    } catch (...) {
+      // Errors are only reported to an explicit Wait().
+    }
+  }
+
+  TaskGroup(const TaskGroup &) = delete;
+  TaskGroup &operator=(const TaskGroup &) = delete;
+
+  // Adds `func` to the group. It is called as func(token) if it accepts a
+  // std::stop_token, and as func() otherwise. Returns false, without
+  // submitting anything, once the group is cancelled.
+  template <class FuncType> const bool Submit(FuncType &&func) {
+    if (state_->stop.stop_requested()) {
+      return false;
+    }
+    Task member;
+    if constexpr (std::is_invocable_v<std::decay_t<FuncType> &,
+                                      std::stop_token>) {
+      member = Task([func_ = std::forward<FuncType>(func),
+                     token = state_->stop.get_token()]() mutable {
+        func_(token);
+      });
+    } else {
+      member = Task(std::forward<FuncType>(func));
+    }
+    state_->pending.fetch_add(1, std::memory_order_relaxed);
+    state_->queue.enqueue(std::move(member));
+    // A Cancel() between the check above and the enqueue may have missed
+    // this member; drain again so it is dropped all the same.
+    if (state_->stop.stop_requested()) {
+      state_->Drain();
+      return false;
+    }
+    executor_.Run(Task([state = state_]() { state->RunOne(); }));
+    return true;
+  }
+
+  // Requests a stop on the group's token and drops every member that has not
+  // started. Members submitted afterwards are rejected.
+  void Cancel() {
+    state_->stop.request_stop();
+    state_->Drain();
+  }
+
+  // Waits until every member has run or been dropped, running queued members
+  // on the calling thread in the meantime. Rethrows the first exception
+  // thrown by a member.
+  void Wait() {
+    size_t pending;
+    while ((pending = state_->pending.load(std::memory_order_acquire)) != 0) {
+      if (!state_->RunOne()) {
+        state_->pending.wait(pending, std::memory_order_acquire);
+      }
+    }
+    std::lock_guard<std::mutex> lock(state_->error_mutex);
+    if (state_->error) {
+      std::rethrow_exception(std::exchange(state_->error, nullptr));
+    }
+  }
+
+  // Token that becomes stop_requested() on Cancel(), for members that take
+  // none as a parameter and for work started outside the group.
+  std::stop_token Token() const { return state_->stop.get_token(); }
+
+  const bool Cancelled() const { return state_->stop.stop_requested(); }
+
+  // Members that have neither finished nor been dropped.
+  const size_t Pending() const {
+    return state_->pending.load(std::memory_order_acquire);
+  }
+
+private:
+  struct State {
+    // Runs the next queued member, if any. Returns false if the group queue
+    // was empty.
+    bool RunOne() {
+      Task member;
+      if (!queue.try_dequeue(member)) {
+        return false;
+      }
+      if (stop.stop_requested()) {
+        LFWP_METRIC_COUNT("task_group.dropped", 1);
+      } else {
+        try {
+          member();
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(error_mutex);
+          if (!error) {
+            error = std::current_exception();
+          }
+        }
+      }
+      Finish(1);
+      return true;
+    }
+
+    void Drain() {
+      Task member;
+      size_t dropped = 0;
+      while (queue.try_dequeue(member)) {
+        ++dropped;
+      }
+      if (dropped > 0) {
+        LFWP_METRIC_COUNT("task_group.dropped", dropped);
+        Finish(dropped);
+      }
+    }
+
+    void Finish(const size_t count) {
+      if (pending.fetch_sub(count, std::memory_order_acq_rel) == count) {
+        pending.notify_all();
+      }
+    }
+
+    moodycamel::ConcurrentQueue<Task> queue;
+    std::stop_source stop;
+    alignas(64) std::atomic<size_t> pending{0};
+    std::mutex error_mutex;
+    std::exception_ptr error;
+  };
+
+  const Executor executor_;
+  std::shared_ptr<State> state_;
+};
+
+} // namespace work_pool
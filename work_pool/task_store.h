@@ -5,8 +5,18 @@
 #include <functional>
 #include <future>
 #include <memory>
+#include <ranges>
 #include <thread>
 #include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "metrics/metrics.h"
+#include "work_pool/coroutine.h"
+#include "work_pool/future.h"
+#include "work_pool/idle_policy.h"
+#include "work_pool/task.h"
 
 namespace work_pool {
 
@@ -15,74 +25,201 @@ template <class Derived> class TaskStore {
   auto derived() const noexcept { return static_cast<const Derived *>(this); }
 
 public:
-  struct Task {
-    std::function<void()> exec;
-
-    // Forward any callable into the std::function.
-    template <typename FuncType>
-    explicit Task(FuncType &&f) : exec(std::forward<FuncType>(f)) {}
-    Task() = default;
-  };
+  using Task = work_pool::Task;
 
   // Submit a task to run and returns a future.
+  //
+  // The function, its arguments and the promise are captured by value in the
+  // task, so unless they exceed Task::kInlineSize the only allocation is the
+  // future's shared state.
   template <typename FuncType, typename... Args>
   auto SubmitAndGetFuture(FuncType &&func, Args &&...args) -> std::future<
       std::invoke_result_t<std::decay_t<FuncType>, std::decay_t<Args>...>> {
     using ResultType =
         std::invoke_result_t<std::decay_t<FuncType>, std::decay_t<Args>...>;
 
-    auto data = std::make_shared<std::tuple<std::decay_t<Args>...>>(
-        std::forward<Args>(args)...);
-
-    auto promise = std::make_shared<std::promise<ResultType>>();
-    auto future = promise->get_future();
+    std::promise<ResultType> promise;
+    auto future = promise.get_future();
 
-    auto work = [func_ = std::forward<FuncType>(func), data,
-                 promise]() mutable {
+    auto work = [func_ = std::forward<FuncType>(func),
+                 data = std::tuple<std::decay_t<Args>...>(
+                     std::forward<Args>(args)...),
+                 promise = std::move(promise)]() mutable {
       if constexpr (std::is_void_v<ResultType>) {
-        std::apply(func_, std::move(*data));
-        promise->set_value();
+        std::apply(func_, std::move(data));
+        promise.set_value();
       } else {
-        promise->set_value(std::apply(func_, std::move(*data)));
+        promise.set_value(std::apply(func_, std::move(data)));
       }
     };
-    derived()->Enqueue(std::make_shared<Task>(std::move(work)));
+    derived()->Enqueue(Task(std::move(work)));
+    return future;
+  }
+
+  // Submit a task to run and returns a work_pool::Future whose continuations
+  // (see Future::Then()) also run on this store, so multi-stage work never
+  // blocks a thread in get(). Exceptions thrown by `func` go to the future.
+  template <typename FuncType, typename... Args>
+  auto Async(FuncType &&func, Args &&...args) -> Future<
+      std::invoke_result_t<std::decay_t<FuncType>, std::decay_t<Args>...>> {
+    using ResultType =
+        std::invoke_result_t<std::decay_t<FuncType>, std::decay_t<Args>...>;
+
+    Promise<ResultType> promise;
+    auto future = promise.GetFuture(derived()->AsExecutor());
+    derived()->Enqueue(Task([func_ = std::forward<FuncType>(func),
+                             data = std::tuple<std::decay_t<Args>...>(
+                                 std::forward<Args>(args)...),
+                             promise = std::move(promise)]() mutable {
+      try {
+        if constexpr (std::is_void_v<ResultType>) {
+          std::apply(func_, std::move(data));
+          promise.SetValue();
+        } else {
+          promise.SetValue(std::apply(func_, std::move(data)));
+        }
+      } catch (...) {
+        promise.SetException(std::current_exception());
+      }
+    }));
     return future;
   }
 
+  // Awaitable that resumes the awaiting coroutine on a consumer of this
+  // store:
+  //
+  //   coro::Task<int> Handle(Request request) {
+  //     co_await store.Schedule();
+  //     ...
+  //   }
+  coro::ScheduleAwaiter<Derived> Schedule() {
+    return coro::ScheduleAwaiter<Derived>(*derived());
+  }
+
   // Submit a task to run and a callback to invoke on the result of the task (if
   // any).
   template <typename FuncType, typename CallbackType, typename... Args>
   void Submit(FuncType &&func, CallbackType &&callback, Args &&...args) {
-    using ResultType =
-        std::invoke_result_t<std::decay_t<FuncType>, std::decay_t<Args>...>;
+    derived()->Enqueue(MakeTask(std::forward<FuncType>(func),
+                                std::forward<CallbackType>(callback),
+                                std::forward<Args>(args)...));
+  }
 
-    auto data = std::make_shared<std::tuple<std::decay_t<Args>...>>(
-        std::forward<Args>(args)...);
+  // Submits every callable in `funcs` in one bulk enqueue. The returned future
+  // becomes ready once all of them ran.
+  template <std::ranges::input_range Range>
+  std::future<void> SubmitBatch(Range &&funcs) {
+    auto promise = std::make_shared<std::promise<void>>();
+    auto future = promise->get_future();
+    SubmitBatch(std::forward<Range>(funcs),
+                [promise = std::move(promise)]() { promise->set_value(); });
+    return future;
+  }
 
-    auto work = [func_ = std::forward<FuncType>(func),
-                 callback_ = std::forward<CallbackType>(callback),
-                 data]() mutable {
-      if constexpr (std::is_void_v<ResultType>) {
-        std::apply(func_, std::move(*data));
-        callback_();
-      } else {
-        callback_(std::apply(func_, std::move(*data)));
-      }
+  // Submits every callable in `funcs` in one bulk enqueue and invokes
+  // `callback` once, on the thread that ran the last of them.
+  template <std::ranges::input_range Range, typename CallbackType>
+  void SubmitBatch(Range &&funcs, CallbackType &&callback) {
+    using FuncType = std::remove_cvref_t<std::ranges::range_reference_t<Range>>;
+    struct Batch {
+      explicit Batch(CallbackType &&callback)
+          : callback(std::forward<CallbackType>(callback)) {}
+
+      std::atomic<size_t> remaining{0};
+      std::decay_t<CallbackType> callback;
     };
-    derived()->Enqueue(std::make_shared<Task>(std::move(work)));
+    auto batch =
+        std::make_shared<Batch>(std::forward<CallbackType>(callback));
+
+    std::vector<Task> tasks;
+    if constexpr (std::ranges::sized_range<Range>) {
+      tasks.reserve(std::ranges::size(funcs));
+    }
+    for (auto &&func : funcs) {
+      FuncType copy = [&]() -> FuncType {
+        // Elements of an rvalue range are ours to move from.
+        if constexpr (std::is_lvalue_reference_v<Range>) {
+          return func;
+        } else {
+          return std::move(func);
+        }
+      }();
+      tasks.emplace_back([func_ = std::move(copy), batch]() mutable {
+        func_();
+        if (batch->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+          batch->callback();
+        }
+      });
+    }
+
+    if (tasks.empty()) {
+      batch->callback();
+      return;
+    }
+    batch->remaining.store(tasks.size(), std::memory_order_relaxed);
+    EnqueueBulk(tasks.data(), tasks.size());
+  }
+
+  // Enqueues a single item (by moving it) and wakes an idle consumer if none
+  // is spinning.
+  inline void Enqueue(Task task) {
+#ifdef LFWP_ENABLE_METRICS
+    task.StampEnqueue();
+#endif
+    LFWP_METRIC_COUNT("task_store.enqueued", 1);
+    derived()->EnqueueImpl(std::move(task));
+    derived()->Idle().NotifyOne();
+  }
+
+  // Dequeues an item if one is available, without blocking.
+  inline bool TryDequeue(Task &task) { return derived()->TryDequeueImpl(task); }
+
+  // Enqueues `count` items (by moving them) and wakes up to `count` idle
+  // consumers. Uses a single bulk queue operation if the store has an
+  // EnqueueBulkImpl().
+  void EnqueueBulk(Task *tasks, const size_t count) {
+#ifdef LFWP_ENABLE_METRICS
+    for (size_t i = 0; i < count; ++i) {
+      tasks[i].StampEnqueue();
+    }
+#endif
+    LFWP_METRIC_COUNT("task_store.enqueued", count);
+    if constexpr (requires(Derived &d) { d.EnqueueBulkImpl(tasks, count); }) {
+      derived()->EnqueueBulkImpl(tasks, count);
+    } else {
+      for (size_t i = 0; i < count; ++i) {
+        derived()->EnqueueImpl(std::move(tasks[i]));
+      }
+    }
+    derived()->Idle().NotifyMany(static_cast<uint32_t>(count));
   }
 
-  // Enqueues a single item (by moving it).
-  inline void Enqueue(std::shared_ptr<Task> task) {
-    derived()->EnqueueImpl(task);
+  // Dequeues up to `max` items without blocking and returns how many. Uses a
+  // single bulk queue operation if the store has a TryDequeueBulkImpl().
+  size_t TryDequeueBulk(Task *tasks, const size_t max) {
+    if constexpr (requires(Derived &d) { d.TryDequeueBulkImpl(tasks, max); }) {
+      return derived()->TryDequeueBulkImpl(tasks, max);
+    } else {
+      size_t n = 0;
+      while (n < max && derived()->TryDequeueImpl(tasks[n])) {
+        ++n;
+      }
+      return n;
+    }
+  }
+
+  // Approximate number of queued items, or 0 if the store cannot tell.
+  size_t SizeApprox() const {
+    if constexpr (requires(const Derived &d) { d.SizeApproxImpl(); }) {
+      return derived()->SizeApproxImpl();
+    } else {
+      return 0;
+    }
   }
 
   // Blocks the current thread until there's something to dequeue, then dequeues
   // it.
-  inline void WaitDequeue(std::shared_ptr<Task> &task) {
-    derived()->WaitDequeueImpl(task);
-  }
+  inline void WaitDequeue(Task &task) { derived()->WaitDequeueImpl(task); }
 
   // Blocks the current thread until either there's something to dequeue
   // or the timeout (specified in microseconds) expires. Returns false
@@ -91,13 +228,46 @@ public:
   // Using a negative timeout indicates an indefinite timeout,
   // and is thus functionally equivalent to calling WaitDequeue.
   template <class Rep, class Period>
-  bool WaitDequeueTimed(std::shared_ptr<Task> &task,
+  bool WaitDequeueTimed(Task &task,
                         const std::chrono::duration<Rep, Period> &duration) {
     return derived()->WaitDequeueTimedImpl(task, duration);
   }
 
+  // This store as the executor of futures and task graphs. Views that only
+  // forward to another store shadow this with the target's.
+  Executor AsExecutor() { return Executor::Of(*derived()); }
+
+  // Where consumers that poll with TryDequeue() spin and park. Stores that
+  // only forward to another store (see PriorityTaskStore::At()) shadow this
+  // with the target's.
+  IdleState &Idle() { return idle_; }
+
 protected:
   TaskStore() = default;
+
+  // Binds `func` and its arguments into a task that passes the result (if
+  // any) to `callback`.
+  template <typename FuncType, typename CallbackType, typename... Args>
+  static Task MakeTask(FuncType &&func, CallbackType &&callback,
+                       Args &&...args) {
+    using ResultType =
+        std::invoke_result_t<std::decay_t<FuncType>, std::decay_t<Args>...>;
+
+    return Task([func_ = std::forward<FuncType>(func),
+                 callback_ = std::forward<CallbackType>(callback),
+                 data = std::tuple<std::decay_t<Args>...>(
+                     std::forward<Args>(args)...)]() mutable {
+      if constexpr (std::is_void_v<ResultType>) {
+        std::apply(func_, std::move(data));
+        callback_();
+      } else {
+        callback_(std::apply(func_, std::move(data)));
+      }
+    });
+  }
+
+private:
+  IdleState idle_;
 };
 
 } // namespace work_pool
\ No newline at end of file
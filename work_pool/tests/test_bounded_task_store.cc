@@ -0,0 +1,154 @@
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "work_pool/bounded_task_store.h"
+#include "work_pool/thread_pool.h"
+
+using work_pool::BoundedTaskStore;
+using Overflow = BoundedTaskStore::Overflow;
+
+namespace {
+
+BoundedTaskStore::Options MakeOptions(const size_t capacity,
+                                      const Overflow overflow) {
+  BoundedTaskStore::Options options;
+  options.capacity = capacity;
+  options.overflow = overflow;
+  return options;
+}
+
+} // namespace
+
+TEST(BoundedTaskStoreTest, CapacityIsRoundedUp) {
+  BoundedTaskStore store(MakeOptions(5, Overflow::kFailFast));
+  EXPECT_EQ(store.Capacity(), 8);
+  BoundedTaskStore tiny(MakeOptions(1, Overflow::kFailFast));
+  EXPECT_EQ(tiny.Capacity(), 2);
+}
+
+TEST(BoundedTaskStoreTest, FailFast) {
+  BoundedTaskStore store(MakeOptions(4, Overflow::kFailFast));
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(store.TrySubmit([]() {}, []() {}));
+  }
+  EXPECT_FALSE(store.TrySubmit([]() {}, []() {}));
+  EXPECT_THROW(store.Submit([]() {}, []() {}), std::runtime_error);
+  EXPECT_EQ(store.SizeApprox(), 4);
+
+  work_pool::Task task;
+  ASSERT_TRUE(store.TryDequeue(task));
+  EXPECT_TRUE(store.TrySubmit([]() {}, []() {}));
+}
+
+TEST(BoundedTaskStoreTest, CallerRuns) {
+  BoundedTaskStore store(MakeOptions(2, Overflow::kCallerRuns));
+  const auto caller = std::this_thread::get_id();
+  std::vector<std::future<bool>> futures;
+  for (int i = 0; i < 3; ++i) {
+    futures.push_back(store.SubmitAndGetFuture(
+        [caller]() { return std::this_thread::get_id() == caller; }));
+  }
+  // The third task ran right away on this thread.
+  ASSERT_EQ(futures[2].wait_for(std::chrono::seconds(0)),
+            std::future_status::ready);
+  EXPECT_TRUE(futures[2].get());
+  EXPECT_EQ(store.SizeApprox(), 2);
+}
+
+TEST(BoundedTaskStoreTest, DropOldest) {
+  BoundedTaskStore store(MakeOptions(2, Overflow::kDropOldest));
+  std::vector<std::future<int>> futures;
+  for (int i = 0; i < 4; ++i) {
+    futures.push_back(store.SubmitAndGetFuture([i]() { return i; }));
+  }
+  EXPECT_EQ(store.Dropped(), 2);
+
+  work_pool::Task task;
+  while (store.TryDequeue(task)) {
+    task();
+  }
+  EXPECT_THROW(futures[0].get(), std::future_error);
+  EXPECT_THROW(futures[1].get(), std::future_error);
+  EXPECT_EQ(futures[2].get(), 2);
+  EXPECT_EQ(futures[3].get(), 3);
+}
+
+TEST(BoundedTaskStoreTest, BlockWaitsForRoom) {
+  BoundedTaskStore store(MakeOptions(2, Overflow::kBlock));
+  store.Submit([]() {}, []() {});
+  store.Submit([]() {}, []() {});
+
+  std::atomic<bool> submitted(false);
+  std::thread producer([&]() {
+    store.Submit([]() {}, []() {});
+    submitted = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_FALSE(submitted.load());
+
+  work_pool::Task task;
+  ASSERT_TRUE(store.TryDequeue(task));
+  producer.join();
+  EXPECT_TRUE(submitted.load());
+}
+
+TEST(BoundedTaskStoreTest, WatermarksAlternate) {
+  std::vector<char> events;
+  BoundedTaskStore::Options options = MakeOptions(8, Overflow::kFailFast);
+  options.high_watermark = 6;
+  options.low_watermark = 2;
+  options.on_high = [&events]() { events.push_back('H'); };
+  options.on_low = [&events]() { events.push_back('L'); };
+  BoundedTaskStore store(std::move(options));
+
+  work_pool::Task task;
+  for (int round = 0; round < 2; ++round) {
+    for (int i = 0; i < 8; ++i) {
+      store.Submit([]() {}, []() {});
+    }
+    while (store.TryDequeue(task)) {
+    }
+  }
+  EXPECT_EQ(events, std::vector<char>({'H', 'L', 'H', 'L'}));
+}
+
+/**
+ * Producers outrun a small ring; with kBlock they wait for the workers and
+ * every task still runs exactly once.
+ */
+TEST(BoundedTaskStoreTest, MultiProducerBlocking) {
+  const int kProducers = 4;
+  const int kTasksPerProducer = 2000;
+
+  std::atomic<int> executed(0);
+  BoundedTaskStore store(MakeOptions(16, Overflow::kBlock));
+  {
+    work_pool::ThreadPool<BoundedTaskStore> pool(store, 2);
+    pool.Start();
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++p) {
+      producers.emplace_back([&store, &executed]() {
+        for (int i = 0; i < kTasksPerProducer; ++i) {
+          store.Submit(
+              [&executed]() {
+                executed.fetch_add(1, std::memory_order_relaxed);
+              },
+              []() {});
+        }
+      });
+    }
+    for (auto &t : producers) {
+      t.join();
+    }
+    while (executed.load() < kProducers * kTasksPerProducer) {
+      std::this_thread::yield();
+    }
+  }
+  EXPECT_EQ(executed.load(), kProducers * kTasksPerProducer);
+}
@@ -0,0 +1,122 @@
+#include <atomic>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "work_pool/coroutine.h"
+#include "work_pool/lock_free_mpmc.h"
+#include "work_pool/thread_pool.h"
+
+using Pool = work_pool::ThreadPool<work_pool::MPMCTaskStore>;
+using work_pool::coro::SyncWait;
+using work_pool::coro::Task;
+
+namespace {
+
+Task<int> Answer() { co_return 42; }
+
+Task<int> Add(int a, int b) { co_return co_await Answer() - 42 + a + b; }
+
+Task<std::thread::id> WorkerId(work_pool::MPMCTaskStore &store) {
+  co_await store.Schedule();
+  co_return std::this_thread::get_id();
+}
+
+Task<int> Throws() {
+  throw std::runtime_error("boom");
+  co_return 0;
+}
+
+// Completes synchronously, so every co_await in the loop below starts and
+// finishes it inline. Symmetric transfer turns those resumptions into tail
+// calls (GCC only emits them with optimization, so keep the count modest).
+Task<int> One() { co_return 1; }
+
+Task<int> SumOfOnes(const int n) {
+  int sum = 0;
+  for (int i = 0; i < n; ++i) {
+    sum += co_await One();
+  }
+  co_return sum;
+}
+
+Task<int> Pooled(work_pool::coro::FrameAllocator &, const int value) {
+  co_return value;
+}
+
+} // namespace
+
+TEST(CoroutineTest, NestedTasks) { EXPECT_EQ(SyncWait(Add(2, 40)), 42); }
+
+TEST(CoroutineTest, ScheduleResumesOnWorker) {
+  work_pool::MPMCTaskStore store;
+  Pool pool(store, 2);
+  pool.Start();
+
+  EXPECT_NE(SyncWait(WorkerId(store)), std::this_thread::get_id());
+}
+
+TEST(CoroutineTest, ExceptionsPropagate) {
+  EXPECT_THROW(SyncWait(Throws()), std::runtime_error);
+
+  auto wrapper = []() -> Task<void> {
+    try {
+      co_await Throws();
+    } catch (const std::runtime_error &) {
+      co_return;
+    }
+    ADD_FAILURE() << "exception not rethrown by co_await";
+  };
+  SyncWait(wrapper());
+}
+
+TEST(CoroutineTest, LongSynchronousChain) {
+  EXPECT_EQ(SyncWait(SumOfOnes(10000)), 10000);
+}
+
+TEST(CoroutineTest, FrameAllocatorRecyclesFrames) {
+  work_pool::coro::FrameAllocator frames;
+  EXPECT_EQ(frames.FreeBlocks(), 0);
+  EXPECT_EQ(SyncWait(Pooled(frames, 1)), 1);
+  EXPECT_EQ(frames.FreeBlocks(), 1);
+  // The second frame reuses the first one's block.
+  EXPECT_EQ(SyncWait(Pooled(frames, 2)), 2);
+  EXPECT_EQ(frames.FreeBlocks(), 1);
+
+  {
+    work_pool::coro::FrameAllocator::Scope scope(frames);
+    EXPECT_EQ(SyncWait(Answer()), 42);
+  }
+  EXPECT_EQ(frames.FreeBlocks(), 1);
+}
+
+/**
+ * Many coroutines hop onto the pool, chain a few awaits there and hop again.
+ * Their frames come from the pool's allocator.
+ */
+TEST(CoroutineTest, ManyCoroutinesOnPool) {
+  const int kCoroutines = 200;
+
+  work_pool::MPMCTaskStore store;
+  Pool pool(store, 4);
+  pool.Start();
+
+  std::atomic<int> total(0);
+  auto handler = [&](int i) -> Task<void> {
+    co_await store.Schedule();
+    const int sum = co_await Add(i, 1);
+    co_await store.Schedule();
+    total += sum;
+  };
+  auto driver = [&]() -> Task<void> {
+    co_await store.Schedule();
+    for (int i = 0; i < kCoroutines; ++i) {
+      co_await handler(i);
+    }
+  };
+  SyncWait(driver());
+
+  EXPECT_EQ(total.load(), kCoroutines * (kCoroutines + 1) / 2);
+  EXPECT_GT(pool.Frames().FreeBlocks(), 0);
+}
@@ -0,0 +1,152 @@
+#include <atomic>
+#include <future>
+#include <gtest/gtest.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "work_pool/future.h"
+#include "work_pool/lock_free_mpmc.h"
+#include "work_pool/thread_pool.h"
+
+using Pool = work_pool::ThreadPool<work_pool::MPMCTaskStore>;
+
+TEST(FutureTest, PromiseAndInlineThen) {
+  work_pool::Promise<int> promise;
+  auto future = promise.GetFuture();
+  EXPECT_FALSE(future.IsReady());
+
+  // No executor: the continuation runs on the thread that sets the value.
+  const auto setter = std::this_thread::get_id();
+  auto next = future.Then([setter](int v) {
+    EXPECT_EQ(std::this_thread::get_id(), setter);
+    return std::to_string(v * 2);
+  });
+  promise.SetValue(21);
+  EXPECT_TRUE(next.IsReady());
+  EXPECT_EQ(next.Get(), "42");
+}
+
+TEST(FutureTest, DroppedTaskBreaksPromise) {
+  auto store = std::make_unique<work_pool::MPMCTaskStore>();
+  auto future = store->Async([] { return 1; });
+  auto next = store->Async([] {}).Then([] { return 2; });
+  // The broken promise travels down a longer chain without being queued on
+  // the store that is going away.
+  auto chain = store->Async([] {})
+                   .Then([] { return 1; })
+                   .Then([](int x) { return x + 1; });
+  std::vector<work_pool::Future<int>> inputs;
+  inputs.push_back(store->Async([] { return 3; }));
+  inputs.push_back(work_pool::MakeReadyFuture(4));
+  auto all = work_pool::WhenAll(std::move(inputs)).Then(
+      [](std::vector<int> values) { return values.size(); });
+  std::vector<work_pool::Future<int>> candidates;
+  candidates.push_back(store->Async([] { return 5; }));
+  auto any = work_pool::WhenAny(std::move(candidates))
+                 .Then([](std::pair<size_t, int> first) {
+                   return first.second;
+                 });
+  // Nobody ran the tasks; destroying the store destroys them.
+  store.reset();
+
+  try {
+    future.Get();
+    FAIL() << "expected a broken promise";
+  } catch (const std::future_error &error) {
+    EXPECT_EQ(error.code(), std::future_errc::broken_promise);
+  }
+  EXPECT_THROW(next.Get(), std::future_error);
+  EXPECT_THROW(chain.Get(), std::future_error);
+  EXPECT_THROW(all.Get(), std::future_error);
+  EXPECT_THROW(any.Get(), std::future_error);
+
+  // A promise that was moved from does not break the future.
+  work_pool::Promise<int> promise;
+  auto kept = promise.GetFuture();
+  {
+    work_pool::Promise<int> moved = std::move(promise);
+    moved.SetValue(3);
+  }
+  EXPECT_EQ(kept.Get(), 3);
+}
+
+TEST(FutureTest, AsyncThenChain) {
+  work_pool::MPMCTaskStore store;
+  Pool pool(store, 2);
+  pool.Start();
+
+  auto result = store.Async([](int a, int b) { return a + b; }, 2, 40)
+                    .Then([](int v) { return v * 10; })
+                    .Then([](int v) { return std::to_string(v); });
+  EXPECT_EQ(result.Get(), "420");
+
+  std::atomic<int> ran(0);
+  store.Async([&ran]() { ran++; }).Then([&ran]() { ran++; }).Get();
+  EXPECT_EQ(ran.load(), 2);
+}
+
+TEST(FutureTest, ExceptionSkipsContinuations) {
+  work_pool::MPMCTaskStore store;
+  Pool pool(store, 2);
+  pool.Start();
+
+  std::atomic<bool> called(false);
+  auto result = store.Async([]() -> int { throw std::runtime_error("boom"); })
+                    .Then([&called](int v) {
+                      called = true;
+                      return v;
+                    });
+  EXPECT_THROW(result.Get(), std::runtime_error);
+  EXPECT_FALSE(called.load());
+}
+
+TEST(FutureTest, WhenAll) {
+  work_pool::MPMCTaskStore store;
+  Pool pool(store, 4);
+  pool.Start();
+
+  std::vector<work_pool::Future<int>> futures;
+  for (int i = 0; i < 50; ++i) {
+    futures.push_back(store.Async([i]() { return i * i; }));
+  }
+  auto sum = work_pool::WhenAll(std::move(futures))
+                 .Then([](std::vector<int> values) {
+                   int total = 0;
+                   for (size_t i = 0; i < values.size(); ++i) {
+                     EXPECT_EQ(values[i], static_cast<int>(i * i));
+                     total += values[i];
+                   }
+                   return total;
+                 });
+  EXPECT_EQ(sum.Get(), 40425);
+
+  std::vector<work_pool::Future<void>> voids;
+  std::atomic<int> ran(0);
+  for (int i = 0; i < 10; ++i) {
+    voids.push_back(store.Async([&ran]() { ran++; }));
+  }
+  work_pool::WhenAll(std::move(voids)).Get();
+  EXPECT_EQ(ran.load(), 10);
+
+  EXPECT_TRUE(work_pool::WhenAll(std::vector<work_pool::Future<int>>())
+                  .Get()
+                  .empty());
+}
+
+TEST(FutureTest, WhenAny) {
+  work_pool::Promise<int> slow;
+  work_pool::Promise<int> fast;
+  std::vector<work_pool::Future<int>> futures;
+  futures.push_back(slow.GetFuture());
+  futures.push_back(fast.GetFuture());
+
+  auto first = work_pool::WhenAny(std::move(futures));
+  fast.SetValue(7);
+  slow.SetValue(1);
+  const auto [index, value] = first.Get();
+  EXPECT_EQ(index, 1);
+  EXPECT_EQ(value, 7);
+}
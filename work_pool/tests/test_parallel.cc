@@ -0,0 +1,107 @@
+#include <atomic>
+#include <gtest/gtest.h>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "work_pool/lock_free_mpmc.h"
+#include "work_pool/parallel.h"
+#include "work_pool/thread_pool.h"
+
+using Pool = work_pool::ThreadPool<work_pool::MPMCTaskStore>;
+
+TEST(ParallelTest, ParallelForVisitsEveryIndexOnce) {
+  work_pool::MPMCTaskStore store;
+  Pool pool(store, 4);
+  pool.Start();
+
+  std::vector<std::atomic<int>> seen(10000);
+  work_pool::ParallelFor(pool, 0, 10000, [&seen](int i) { seen[i]++; });
+  for (int i = 0; i < 10000; ++i) {
+    ASSERT_EQ(seen[i].load(), 1) << "index " << i;
+  }
+
+  // Empty and reversed ranges do nothing.
+  work_pool::ParallelFor(pool, 5, 5, [](int) { FAIL(); });
+  work_pool::ParallelFor(pool, 5, 3, [](int) { FAIL(); });
+}
+
+TEST(ParallelTest, ParallelForRethrows) {
+  work_pool::MPMCTaskStore store;
+  Pool pool(store, 4);
+  pool.Start();
+
+  std::atomic<int> ran(0);
+  EXPECT_THROW(work_pool::ParallelFor(pool, 0, 1000,
+                                      [&ran](int i) {
+                                        ran++;
+                                        if (i == 500) {
+                                          throw std::runtime_error("boom");
+                                        }
+                                      }),
+               std::runtime_error);
+  EXPECT_GT(ran.load(), 0);
+}
+
+/**
+ * Every worker runs a ParallelFor of its own. The callers take part in their
+ * loops, so this completes although no worker is free to help.
+ */
+TEST(ParallelTest, NestedParallelForFromWorkers) {
+  work_pool::MPMCTaskStore store;
+  Pool pool(store, 2);
+  pool.Start();
+
+  std::atomic<int> total(0);
+  work_pool::ParallelFor(pool, 0, 8, [&](int) {
+    work_pool::ParallelFor(pool, 0, 100, [&total](int) { total++; });
+  });
+  EXPECT_EQ(total.load(), 800);
+}
+
+TEST(ParallelTest, ParallelReduceKeepsOrder) {
+  work_pool::MPMCTaskStore store;
+  Pool pool(store, 4);
+  pool.Start();
+
+  std::vector<int> values(100000);
+  std::iota(values.begin(), values.end(), 1);
+  EXPECT_EQ(work_pool::ParallelReduce(pool, values, int64_t{0},
+                                      [](int64_t a, int64_t b) {
+                                        return a + b;
+                                      }),
+            int64_t{100000} * 100001 / 2);
+
+  // String concatenation is associative but not commutative.
+  std::vector<std::string> letters;
+  std::string expected = ">";
+  for (int i = 0; i < 2000; ++i) {
+    letters.push_back(std::string(1, static_cast<char>('a' + i % 26)));
+    expected += letters.back();
+  }
+  EXPECT_EQ(work_pool::ParallelReduce(
+                pool, letters, std::string(">"),
+                [](std::string a, const std::string &b) { return a + b; },
+                /*grain=*/16),
+            expected);
+}
+
+TEST(ParallelTest, ParallelScanMatchesInclusiveScan) {
+  work_pool::MPMCTaskStore store;
+  Pool pool(store, 3);
+  pool.Start();
+
+  for (size_t size : {1, 7, 20, 1000, 12345}) {
+    std::vector<int64_t> values(size);
+    std::iota(values.begin(), values.end(), 3);
+    std::vector<int64_t> expected(size);
+    std::inclusive_scan(values.begin(), values.end(), expected.begin(),
+                        std::plus<>(), int64_t{10});
+
+    std::vector<int64_t> out(size);
+    work_pool::ParallelScan(pool, values, out.begin(), int64_t{10},
+                            std::plus<>());
+    EXPECT_EQ(out, expected) << "size " << size;
+  }
+}
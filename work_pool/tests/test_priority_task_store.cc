@@ -0,0 +1,119 @@
+#include <atomic>
+#include <chrono>
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+#include "work_pool/priority_task_store.h"
+#include "work_pool/thread_pool.h"
+
+using work_pool::Priority;
+using work_pool::PriorityTaskStore;
+
+namespace {
+
+// Enqueues a task that appends `id` to `order`.
+void Push(PriorityTaskStore &store, const Priority priority,
+          std::vector<int> &order, const int id) {
+  store.At(priority).Enqueue(
+      work_pool::Task([&order, id]() { order.push_back(id); }));
+}
+
+// Dequeues and runs everything in the store on the calling thread.
+void RunAll(PriorityTaskStore &store) {
+  work_pool::Task task;
+  while (store.TryDequeue(task)) {
+    task();
+    task.Reset();
+  }
+}
+
+} // namespace
+
+TEST(PriorityTaskStoreTest, StrictDrainsByPriority) {
+  PriorityTaskStore store;
+  std::vector<int> order;
+  Push(store, Priority::kLow, order, 3);
+  Push(store, Priority::kNormal, order, 2);
+  Push(store, Priority::kHigh, order, 1);
+  Push(store, Priority::kLow, order, 4);
+  store.Enqueue(work_pool::Task([&order]() { order.push_back(0); }));
+
+  RunAll(store);
+  EXPECT_EQ(order, std::vector<int>({1, 2, 0, 3, 4}));
+}
+
+TEST(PriorityTaskStoreTest, WeightedDrainServesEveryClass) {
+  PriorityTaskStore store(PriorityTaskStore::Drain::kWeighted, {8, 4, 1});
+  std::vector<int> order;
+  for (int i = 0; i < 100; ++i) {
+    Push(store, Priority::kHigh, order, 0);
+    Push(store, Priority::kNormal, order, 1);
+    Push(store, Priority::kLow, order, 2);
+  }
+
+  // 26 dequeues are two full rounds of the 8/4/1 schedule.
+  work_pool::Task task;
+  for (int i = 0; i < 26; ++i) {
+    ASSERT_TRUE(store.TryDequeue(task));
+    task();
+  }
+  int counts[3] = {0, 0, 0};
+  for (const int cls : order) {
+    ++counts[cls];
+  }
+  EXPECT_EQ(counts[0], 16);
+  EXPECT_EQ(counts[1], 8);
+  EXPECT_EQ(counts[2], 2);
+}
+
+TEST(PriorityTaskStoreTest, DeadlineLaneIsEarliestDeadlineFirst) {
+  PriorityTaskStore store;
+  const auto now = PriorityTaskStore::Clock::now();
+  std::vector<int> order;
+  Push(store, Priority::kHigh, order, 100);
+  for (const int ms : {30, 10, 20}) {
+    store.At(Priority::kLow, now + std::chrono::milliseconds(ms))
+        .Enqueue(work_pool::Task([&order, ms]() { order.push_back(ms); }));
+  }
+
+  RunAll(store);
+  EXPECT_EQ(order, std::vector<int>({10, 20, 30, 100}));
+}
+
+TEST(PriorityTaskStoreTest, StatsTrackDepthAndWait) {
+  PriorityTaskStore store;
+  std::vector<int> order;
+  Push(store, Priority::kLow, order, 1);
+  Push(store, Priority::kLow, order, 2);
+  EXPECT_EQ(store.GetStats(Priority::kLow).depth, 2);
+  EXPECT_EQ(store.GetStats(Priority::kHigh).depth, 0);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  RunAll(store);
+  const auto stats = store.GetStats(Priority::kLow);
+  EXPECT_EQ(stats.depth, 0);
+  EXPECT_EQ(stats.dequeued, 2);
+  EXPECT_GE(stats.max_wait_ns, 2000000);
+  EXPECT_GE(stats.total_wait_ns, stats.max_wait_ns);
+}
+
+/**
+ * Submitting through a class view must wake parked ThreadPool workers.
+ */
+TEST(PriorityTaskStoreTest, WorksWithThreadPool) {
+  PriorityTaskStore store(PriorityTaskStore::Drain::kWeighted);
+  work_pool::ThreadPool<PriorityTaskStore> pool(store, 2);
+  pool.Start();
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+  auto high = store.At(Priority::kHigh).SubmitAndGetFuture(
+      [](int a, int b) { return a + b; }, 2, 40);
+  auto low = store.At(Priority::kLow).SubmitAndGetFuture([]() { return 7; });
+  auto deadline =
+      store.At(Priority::kNormal, PriorityTaskStore::Clock::now())
+          .SubmitAndGetFuture([]() { return 1; });
+  EXPECT_EQ(high.get(), 42);
+  EXPECT_EQ(low.get(), 7);
+  EXPECT_EQ(deadline.get(), 1);
+}
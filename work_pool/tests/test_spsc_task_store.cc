@@ -0,0 +1,156 @@
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+#include "work_pool/spsc_task_store.h"
+#include "work_pool/thread_pool.h"
+
+using work_pool::SpscTaskStore;
+
+namespace {
+
+// Runs everything in the store on the calling thread.
+void RunAll(SpscTaskStore &store) {
+  work_pool::Task task;
+  while (store.TryDequeue(task)) {
+    task();
+    task.Reset();
+  }
+}
+
+} // namespace
+
+TEST(SpscRingTest, WrapsAndFills) {
+  work_pool::SpscRing ring(4);
+  std::vector<int> out;
+  for (int round = 0; round < 3; ++round) {
+    for (int i = 0; i < 4; ++i) {
+      work_pool::Task task([&out, i] { out.push_back(i); });
+      ASSERT_TRUE(ring.TryPush(task));
+    }
+    work_pool::Task extra([] {});
+    EXPECT_FALSE(ring.TryPush(extra));
+    EXPECT_TRUE(extra);
+    EXPECT_EQ(ring.SizeApprox(), 4);
+
+    work_pool::Task tasks[8];
+    ASSERT_EQ(ring.TryPopBulk(tasks, 8), 4);
+    for (int i = 0; i < 4; ++i) {
+      tasks[i]();
+    }
+    EXPECT_TRUE(ring.EmptyApprox());
+  }
+  EXPECT_EQ(out, (std::vector<int>{0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3}));
+}
+
+TEST(SpscTaskStoreTest, FullLaneOverflows) {
+  SpscTaskStore store(SpscTaskStore::Options{.num_lanes = 1,
+                                             .lane_capacity = 4});
+  std::vector<int> order;
+  for (int i = 0; i < 10; ++i) {
+    store.Enqueue(work_pool::Task([&order, i] { order.push_back(i); }));
+  }
+  EXPECT_EQ(store.SizeApprox(), 10);
+  RunAll(store);
+  // The lane is drained before the overflow queue.
+  EXPECT_EQ(order, (std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+}
+
+TEST(SpscTaskStoreTest, OverflowNotStarvedByBusyLane) {
+  SpscTaskStore store(SpscTaskStore::Options{.num_lanes = 1,
+                                             .lane_capacity = 4});
+  int lane_runs = 0;
+  bool overflow_ran = false;
+  for (int i = 0; i < 4; ++i) {
+    store.Enqueue(work_pool::Task([&lane_runs] { ++lane_runs; }));
+  }
+  store.Enqueue(work_pool::Task([&overflow_ran] { overflow_ran = true; }));
+
+  // Every task taken from the lane is replaced right away, so the lane
+  // never runs dry.
+  work_pool::Task task;
+  for (int i = 0; i < 1000 && !overflow_ran; ++i) {
+    ASSERT_TRUE(store.TryDequeue(task));
+    task();
+    task.Reset();
+    if (!overflow_ran) {
+      store.Enqueue(work_pool::Task([&lane_runs] { ++lane_runs; }));
+    }
+  }
+  EXPECT_TRUE(overflow_ran);
+  EXPECT_LE(lane_runs, 100);
+  EXPECT_EQ(store.SizeApprox(), 4);
+  RunAll(store);
+}
+
+TEST(SpscTaskStoreTest, HandsOffToSpinningConsumer) {
+  SpscTaskStore store(SpscTaskStore::Options{.num_lanes = 1,
+                                             .lane_capacity = 1});
+  std::vector<char> order;
+  const auto push = [&](const char name) {
+    store.Enqueue(work_pool::Task([&order, name] { order.push_back(name); }));
+  };
+  push('a'); // Nobody spins: lane.
+  ASSERT_TRUE(store.Idle().TryStartSpinning(1));
+  push('b'); // Handoff slot.
+  push('c'); // Slot taken, lane full: overflow.
+  store.Idle().StopSpinning(false);
+  EXPECT_EQ(store.SizeApprox(), 3);
+  RunAll(store);
+  EXPECT_EQ(order, (std::vector<char>{'b', 'a', 'c'}));
+}
+
+/**
+ * More producers than lanes share them; every task runs exactly once on a
+ * pool whose workers spin, so handoffs happen too.
+ */
+TEST(SpscTaskStoreTest, MultiProducerWithThreadPool) {
+  constexpr int kProducers = 6;
+  constexpr int kTasks = 5000;
+  SpscTaskStore store(SpscTaskStore::Options{.num_lanes = 4,
+                                             .lane_capacity = 64});
+  std::atomic<int> executed{0};
+  {
+    work_pool::ThreadPool pool(store, 3);
+    pool.Start();
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++p) {
+      producers.emplace_back([&store, &executed] {
+        std::vector<std::future<void>> futures;
+        for (int i = 0; i < kTasks; ++i) {
+          futures.push_back(store.SubmitAndGetFuture(
+              [&executed] { executed.fetch_add(1); }));
+        }
+        for (auto &future : futures) {
+          future.get();
+        }
+      });
+    }
+    for (auto &producer : producers) {
+      producer.join();
+    }
+  }
+  EXPECT_EQ(executed.load(), kProducers * kTasks);
+}
+
+TEST(SpscTaskStoreTest, SubmitBatchAndWaitDequeue) {
+  SpscTaskStore store(SpscTaskStore::Options{.num_lanes = 2,
+                                             .lane_capacity = 8});
+  std::atomic<int> done{0};
+  std::vector<std::function<void()>> funcs(20, [&done] { done.fetch_add(1); });
+  auto future = store.SubmitBatch(funcs);
+
+  work_pool::Task task;
+  for (int i = 0; i < 20; ++i) {
+    store.WaitDequeue(task);
+    task();
+    task.Reset();
+  }
+  future.get();
+  EXPECT_EQ(done.load(), 20);
+  EXPECT_FALSE(store.WaitDequeueTimed(task, std::chrono::milliseconds(1)));
+}
@@ -0,0 +1,81 @@
+#include <array>
+#include <future>
+#include <gtest/gtest.h>
+#include <memory>
+#include <utility>
+
+#include "work_pool/task.h"
+
+namespace {
+
+// Counts live copies of itself so tests can check that captured state is
+// destroyed exactly once.
+struct Tracker {
+  explicit Tracker(int *live) : live(live) { ++*live; }
+  Tracker(Tracker &&other) noexcept : live(other.live) { ++*live; }
+  ~Tracker() { --*live; }
+  int *live;
+};
+
+} // namespace
+
+TEST(TaskTest, DefaultIsEmpty) {
+  work_pool::Task task;
+  EXPECT_FALSE(task);
+  EXPECT_FALSE(task.IsInline());
+}
+
+TEST(TaskTest, SmallCallableIsInline) {
+  int calls = 0;
+  work_pool::Task task([&calls]() { ++calls; });
+  ASSERT_TRUE(task);
+  EXPECT_TRUE(task.IsInline());
+
+  task();
+  task();
+  EXPECT_EQ(calls, 2);
+
+  task.Reset();
+  EXPECT_FALSE(task);
+}
+
+TEST(TaskTest, PromiseAndArgumentsFitInline) {
+  std::promise<int> promise;
+  auto future = promise.get_future();
+  work_pool::Task task(
+      [f = +[](int a, int b) { return a + b; }, a = 2, b = 40,
+       promise = std::move(promise)]() mutable { promise.set_value(f(a, b)); });
+  EXPECT_TRUE(task.IsInline());
+
+  task();
+  EXPECT_EQ(future.get(), 42);
+}
+
+TEST(TaskTest, LargeCallableFallsBackToHeap) {
+  std::array<char, 128> payload{};
+  payload[127] = 7;
+  int result = 0;
+  work_pool::Task task([payload, &result]() { result = payload[127]; });
+  EXPECT_FALSE(task.IsInline());
+
+  work_pool::Task moved(std::move(task));
+  EXPECT_FALSE(task);
+  moved();
+  EXPECT_EQ(result, 7);
+}
+
+TEST(TaskTest, MoveOnlyCaptureDestroyedOnce) {
+  int live = 0;
+  {
+    work_pool::Task task([tracker = Tracker(&live),
+                          owned = std::make_unique<int>(5)]() {});
+    EXPECT_EQ(live, 1);
+
+    work_pool::Task other;
+    other = std::move(task);
+    EXPECT_EQ(live, 1);
+    EXPECT_FALSE(task);
+    EXPECT_TRUE(other);
+  }
+  EXPECT_EQ(live, 0);
+}
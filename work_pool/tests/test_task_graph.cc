@@ -0,0 +1,110 @@
+#include <atomic>
+#include <gtest/gtest.h>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "work_pool/lock_free_mpmc.h"
+#include "work_pool/task_graph.h"
+#include "work_pool/thread_pool.h"
+
+using Pool = work_pool::ThreadPool<work_pool::MPMCTaskStore>;
+
+TEST(TaskGraphTest, RunsInDependencyOrder) {
+  work_pool::MPMCTaskStore store;
+  Pool pool(store, 4);
+  pool.Start();
+
+  // Diamond: a -> {b, c} -> d.
+  std::mutex mutex;
+  std::vector<char> order;
+  auto record = [&](char c) {
+    return [&, c]() {
+      std::lock_guard<std::mutex> lock(mutex);
+      order.push_back(c);
+    };
+  };
+  work_pool::TaskGraph graph;
+  const auto a = graph.Add(record('a'));
+  const auto b = graph.Add(record('b'));
+  const auto c = graph.Add(record('c'));
+  const auto d = graph.Add(record('d'));
+  graph.Precede(a, b);
+  graph.Precede(a, c);
+  graph.Precede(b, d);
+  graph.Precede(c, d);
+
+  for (int run = 0; run < 20; ++run) {
+    order.clear();
+    graph.Run(store).Get();
+    ASSERT_EQ(order.size(), 4);
+    EXPECT_EQ(order.front(), 'a');
+    EXPECT_EQ(order.back(), 'd');
+  }
+}
+
+/**
+ * A wide pipeline: many independent chains of stages. Every stage must see
+ * the previous stage of its chain done.
+ */
+TEST(TaskGraphTest, ManyChains) {
+  const int kChains = 64;
+  const int kStages = 8;
+
+  work_pool::MPMCTaskStore store;
+  Pool pool(store, 4);
+  pool.Start();
+
+  std::vector<std::atomic<int>> progress(kChains);
+  std::atomic<int> violations(0);
+  work_pool::TaskGraph graph;
+  for (int chain = 0; chain < kChains; ++chain) {
+    work_pool::TaskGraph::NodeId previous = 0;
+    for (int stage = 0; stage < kStages; ++stage) {
+      const auto id = graph.Add([&progress, &violations, chain, stage]() {
+        if (progress[chain].exchange(stage + 1) != stage) {
+          violations++;
+        }
+      });
+      if (stage > 0) {
+        graph.Precede(previous, id);
+      }
+      previous = id;
+    }
+  }
+
+  graph.Run(store).Get();
+  EXPECT_EQ(violations.load(), 0);
+  for (int chain = 0; chain < kChains; ++chain) {
+    EXPECT_EQ(progress[chain].load(), kStages);
+  }
+}
+
+TEST(TaskGraphTest, ExceptionSkipsSuccessors) {
+  work_pool::MPMCTaskStore store;
+  Pool pool(store, 2);
+  pool.Start();
+
+  std::atomic<bool> ran(false);
+  work_pool::TaskGraph graph;
+  const auto a = graph.Add([]() { throw std::runtime_error("boom"); });
+  const auto b = graph.Add([&ran]() { ran = true; });
+  graph.Precede(a, b);
+
+  EXPECT_THROW(graph.Run(store).Get(), std::runtime_error);
+  EXPECT_FALSE(ran.load());
+}
+
+TEST(TaskGraphTest, RejectsCycles) {
+  work_pool::MPMCTaskStore store;
+  work_pool::TaskGraph graph;
+  const auto a = graph.Add([]() {});
+  const auto b = graph.Add([]() {});
+  graph.Precede(a, b);
+  graph.Precede(b, a);
+  EXPECT_THROW(graph.Run(store), std::runtime_error);
+  EXPECT_THROW(graph.Precede(a, 5), std::runtime_error);
+
+  // An empty graph is done right away.
+  EXPECT_TRUE(work_pool::TaskGraph().Run(store).IsReady());
+}
@@ -0,0 +1,142 @@
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <gtest/gtest.h>
+#include <memory>
+#include <stdexcept>
+#include <stop_token>
+#include <thread>
+
+#include "work_pool/lock_free_mpmc.h"
+#include "work_pool/task_group.h"
+#include "work_pool/thread_pool.h"
+
+using Pool = work_pool::ThreadPool<work_pool::MPMCTaskStore>;
+
+TEST(TaskGroupTest, WaitRunsEveryMember) {
+  work_pool::MPMCTaskStore store;
+  Pool pool(store, 4);
+  pool.Start();
+
+  std::atomic<int> executed{0};
+  work_pool::TaskGroup group(store);
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_TRUE(group.Submit([&executed] { executed.fetch_add(1); }));
+  }
+  group.Wait();
+  EXPECT_EQ(executed.load(), 1000);
+  EXPECT_EQ(group.Pending(), 0);
+}
+
+TEST(TaskGroupTest, WaitHelpsWithoutWorkers) {
+  // Nobody consumes the store, so Wait() has to run the members itself.
+  work_pool::MPMCTaskStore store;
+  int executed = 0;
+  {
+    work_pool::TaskGroup group(store);
+    for (int i = 0; i < 10; ++i) {
+      group.Submit([&executed] { ++executed; });
+    }
+    group.Wait();
+    EXPECT_EQ(executed, 10);
+  }
+  // The trampolines outlive the group and find its queue empty.
+  work_pool::Task task;
+  int trampolines = 0;
+  while (store.TryDequeue(task)) {
+    task();
+    ++trampolines;
+  }
+  EXPECT_EQ(trampolines, 10);
+  EXPECT_EQ(executed, 10);
+}
+
+TEST(TaskGroupTest, CancelDropsQueuedMembers) {
+  work_pool::MPMCTaskStore store;
+  std::atomic<int> executed{0};
+  work_pool::TaskGroup group(store);
+  for (int i = 0; i < 100; ++i) {
+    group.Submit([&executed] { executed.fetch_add(1); });
+  }
+  EXPECT_EQ(group.Pending(), 100);
+
+  group.Cancel();
+  EXPECT_TRUE(group.Cancelled());
+  EXPECT_TRUE(group.Token().stop_requested());
+  EXPECT_EQ(group.Pending(), 0);
+  EXPECT_FALSE(group.Submit([&executed] { executed.fetch_add(1); }));
+
+  work_pool::Task task;
+  while (store.TryDequeue(task)) {
+    task();
+  }
+  group.Wait();
+  EXPECT_EQ(executed.load(), 0);
+}
+
+/**
+ * Members that are already running keep running until they observe the stop
+ * token; the queued rest is dropped. Wait() returns once the running ones
+ * stop.
+ */
+TEST(TaskGroupTest, RunningMembersSeeStopToken) {
+  constexpr int kWorkers = 2;
+  work_pool::MPMCTaskStore store;
+  Pool pool(store, kWorkers);
+  pool.Start();
+
+  std::atomic<int> started{0};
+  std::atomic<int> stopped{0};
+  work_pool::TaskGroup group(store);
+  for (int i = 0; i < 50; ++i) {
+    group.Submit([&](std::stop_token token) {
+      started.fetch_add(1);
+      while (!token.stop_requested()) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+      }
+      stopped.fetch_add(1);
+    });
+  }
+  while (started.load() < kWorkers) {
+    std::this_thread::yield();
+  }
+  group.Cancel();
+  group.Wait();
+  EXPECT_EQ(started.load(), kWorkers);
+  EXPECT_EQ(stopped.load(), kWorkers);
+}
+
+TEST(TaskGroupTest, WaitRethrowsFirstError) {
+  work_pool::MPMCTaskStore store;
+  Pool pool(store, 2);
+  pool.Start();
+
+  std::atomic<int> executed{0};
+  work_pool::TaskGroup group(store);
+  group.Submit([] { throw std::runtime_error("failed!"); });
+  for (int i = 0; i < 10; ++i) {
+    group.Submit([&executed] { executed.fetch_add(1); });
+  }
+  EXPECT_THROW(group.Wait(), std::runtime_error);
+  EXPECT_EQ(executed.load(), 10);
+  // The error is reported once.
+  group.Wait();
+}
+
+TEST(TaskGroupTest, DestructorWaitsForMembers) {
+  work_pool::MPMCTaskStore store;
+  Pool pool(store, 2);
+  pool.Start();
+
+  std::atomic<int> executed{0};
+  {
+    work_pool::TaskGroup group(store);
+    for (int i = 0; i < 20; ++i) {
+      group.Submit([&executed] {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        executed.fetch_add(1);
+      });
+    }
+  }
+  EXPECT_EQ(executed.load(), 20);
+}
@@ -0,0 +1,302 @@
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <gtest/gtest.h>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "work_pool/event_count.h"
+#include "work_pool/lock_free_mpmc.h"
+#include "work_pool/thread_pool.h"
+
+using Pool = work_pool::ThreadPool<work_pool::MPMCTaskStore>;
+
+TEST(EventCountTest, NotifyAfterPrepareWakes) {
+  work_pool::EventCount event;
+  const auto key = event.PrepareWait();
+  event.NotifyOne();
+  // The epoch moved on, so this returns immediately.
+  event.Wait(key);
+
+  const auto stale = event.PrepareWait();
+  EXPECT_FALSE(event.WaitUntil(stale, std::chrono::steady_clock::now() +
+                                          std::chrono::milliseconds(1)));
+}
+
+TEST(ThreadPoolTest, SubmitAndGetFuture) {
+  work_pool::MPMCTaskStore store;
+  Pool pool(store, 2);
+  pool.Start();
+
+  auto future = store.SubmitAndGetFuture([](int a, int b) { return a + b; },
+                                         2, 40);
+  EXPECT_EQ(future.get(), 42);
+}
+
+/**
+ * With spinning disabled every idle worker parks; tasks submitted afterwards
+ * must still wake them up.
+ */
+TEST(ThreadPoolTest, ParkedWorkersWakeUp) {
+  work_pool::IdlePolicy policy;
+  policy.max_spinning = 0;
+
+  work_pool::MPMCTaskStore store;
+  Pool pool(store, 4, policy);
+  pool.Start();
+
+  for (int round = 0; round < 20; ++round) {
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+    std::vector<std::future<int>> futures;
+    for (int i = 0; i < 8; ++i) {
+      futures.push_back(store.SubmitAndGetFuture([i]() { return i; }));
+    }
+    for (int i = 0; i < 8; ++i) {
+      ASSERT_EQ(futures[i].get(), i);
+    }
+  }
+}
+
+/**
+ * Many producers race against spinning and parking workers. Every task must
+ * run exactly once.
+ */
+TEST(ThreadPoolTest, MultiProducerAllTasksRun) {
+  const int kProducers = 4;
+  const int kTasksPerProducer = 2000;
+
+  std::atomic<int> executed(0);
+  work_pool::MPMCTaskStore store;
+  {
+    Pool pool(store, 4);
+    pool.Start();
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++p) {
+      producers.emplace_back([&store, &executed]() {
+        for (int i = 0; i < kTasksPerProducer; ++i) {
+          store.Submit(
+              [&executed]() {
+                executed.fetch_add(1, std::memory_order_relaxed);
+              },
+              []() {});
+          if (i % 256 == 0) {
+            std::this_thread::yield();
+          }
+        }
+      });
+    }
+    for (auto &t : producers) {
+      t.join();
+    }
+    while (executed.load() < kProducers * kTasksPerProducer) {
+      std::this_thread::yield();
+    }
+  }
+
+  EXPECT_EQ(executed.load(), kProducers * kTasksPerProducer);
+}
+
+TEST(ThreadPoolTest, SubmitBatch) {
+  work_pool::MPMCTaskStore store;
+  Pool pool(store, 4);
+  pool.Start();
+
+  std::vector<std::atomic<int>> ran(500);
+  std::vector<std::function<void()>> funcs;
+  for (int i = 0; i < 500; ++i) {
+    funcs.push_back([&ran, i]() { ran[i].fetch_add(1); });
+  }
+  store.SubmitBatch(funcs).get();
+  for (int i = 0; i < 500; ++i) {
+    ASSERT_EQ(ran[i].load(), 1) << "task " << i;
+  }
+
+  // Empty batches complete right away.
+  store.SubmitBatch(std::vector<std::function<void()>>()).get();
+}
+
+TEST(ThreadPoolTest, SubmitBatchCallbackRunsOnceAfterAllTasks) {
+  work_pool::MPMCTaskStore store;
+  Pool pool(store, 4);
+  pool.Start();
+
+  std::atomic<int> executed(0);
+  std::atomic<int> callbacks(0);
+  std::promise<int> seen;
+  std::vector<std::function<void()>> funcs(
+      100, [&executed]() { executed.fetch_add(1); });
+  store.SubmitBatch(std::move(funcs), [&]() {
+    callbacks.fetch_add(1);
+    seen.set_value(executed.load());
+  });
+
+  EXPECT_EQ(seen.get_future().get(), 100);
+  EXPECT_EQ(callbacks.load(), 1);
+}
+
+/**
+ * Several producers submit batches concurrently; each goes through its own
+ * producer token. Every task must run exactly once.
+ */
+TEST(ThreadPoolTest, MultiProducerBatches) {
+  const int kProducers = 4;
+  const int kBatches = 50;
+  const int kBatchSize = 64;
+
+  std::atomic<int> executed(0);
+  work_pool::MPMCTaskStore store;
+  Pool pool(store, 4);
+  pool.Start();
+
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kProducers; ++p) {
+    producers.emplace_back([&store, &executed]() {
+      std::vector<std::future<void>> futures;
+      for (int b = 0; b < kBatches; ++b) {
+        std::vector<std::function<void()>> funcs(
+            kBatchSize, [&executed]() { executed.fetch_add(1); });
+        futures.push_back(store.SubmitBatch(std::move(funcs)));
+      }
+      for (auto &f : futures) {
+        f.get();
+      }
+    });
+  }
+  for (auto &t : producers) {
+    t.join();
+  }
+
+  EXPECT_EQ(executed.load(), kProducers * kBatches * kBatchSize);
+}
+
+/**
+ * Producer tokens are cached per thread for a few stores at a time and go
+ * back to their store when the thread exits, so short-lived producers do
+ * not pile up tokens.
+ */
+TEST(ThreadPoolTest, ProducerTokensFollowThreads) {
+  work_pool::MPMCTaskStore first;
+  work_pool::MPMCTaskStore second;
+  work_pool::Task task;
+
+  for (int round = 0; round < 20; ++round) {
+    std::thread producer([&] {
+      for (int i = 0; i < 100; ++i) {
+        first.Enqueue(work_pool::Task([] {}));
+        second.Enqueue(work_pool::Task([] {}));
+      }
+      EXPECT_EQ(first.NumProducerTokens(), 1);
+      EXPECT_EQ(second.NumProducerTokens(), 1);
+    });
+    producer.join();
+    EXPECT_EQ(first.NumProducerTokens(), 0);
+    EXPECT_EQ(second.NumProducerTokens(), 0);
+  }
+
+  // A thread can outlive the store whose token it caches.
+  std::thread producer([] {
+    work_pool::MPMCTaskStore transient;
+    transient.Enqueue(work_pool::Task([] {}));
+  });
+  producer.join();
+
+  int dequeued = 0;
+  while (first.TryDequeue(task) && second.TryDequeue(task)) {
+    ++dequeued;
+  }
+  EXPECT_EQ(dequeued, 2000);
+}
+
+TEST(ThreadPoolTest, ShutdownWakesParkedWorkers) {
+  work_pool::MPMCTaskStore store;
+  auto pool = std::make_unique<Pool>(store, 8);
+  pool->Start();
+  // Let every worker run out of spin budget and park.
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  const auto start = std::chrono::steady_clock::now();
+  pool.reset();
+  EXPECT_LT(std::chrono::steady_clock::now() - start,
+            std::chrono::milliseconds(50));
+}
+
+TEST(ThreadPoolTest, InvalidElasticBounds) {
+  work_pool::MPMCTaskStore store;
+  EXPECT_THROW(Pool(store, work_pool::ElasticPolicy{.min_threads = 0}),
+               std::runtime_error);
+  EXPECT_THROW(
+      Pool(store, work_pool::ElasticPolicy{.min_threads = 4, .max_threads = 2}),
+      std::runtime_error);
+  // Outside a pool worker a blocking region does nothing.
+  work_pool::BlockingRegion blocking;
+}
+
+/**
+ * Tasks that can only finish once all of them run at the same time force a
+ * single-worker elastic pool to add a worker per BlockingRegion. The extra
+ * workers retire once idle.
+ */
+TEST(ThreadPoolTest, BlockingRegionAddsWorkers) {
+  constexpr int kTasks = 4;
+  work_pool::MPMCTaskStore store;
+  Pool pool(store, work_pool::ElasticPolicy{
+                       .min_threads = 1,
+                       .max_threads = kTasks,
+                       .idle_timeout = std::chrono::milliseconds(20),
+                       .watchdog_interval = std::chrono::hours(1)});
+  pool.Start();
+  EXPECT_EQ(pool.NumThreads(), 1);
+
+  std::atomic<int> arrived{0};
+  std::vector<std::future<void>> futures;
+  for (int i = 0; i < kTasks; ++i) {
+    futures.push_back(store.SubmitAndGetFuture([&arrived] {
+      work_pool::BlockingRegion blocking;
+      arrived.fetch_add(1);
+      while (arrived.load() < kTasks) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+      }
+    }));
+  }
+  for (auto &future : futures) {
+    future.get();
+  }
+  EXPECT_EQ(pool.NumThreads(), kTasks);
+
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (pool.NumThreads() > 1 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  EXPECT_EQ(pool.NumThreads(), 1);
+  // The pool still works after shrinking.
+  EXPECT_EQ(store.SubmitAndGetFuture([] { return 7; }).get(), 7);
+}
+
+/**
+ * A task that waits for a later task, without a BlockingRegion, is found
+ * stuck by the watchdog, which adds a worker to run the later task.
+ */
+TEST(ThreadPoolTest, WatchdogGrowsOnStalledWorker) {
+  work_pool::MPMCTaskStore store;
+  Pool pool(store, work_pool::ElasticPolicy{
+                       .min_threads = 1,
+                       .max_threads = 2,
+                       .watchdog_interval = std::chrono::milliseconds(1)});
+  pool.Start();
+
+  std::atomic<bool> released{false};
+  auto waiter = store.SubmitAndGetFuture([&released] {
+    while (!released.load()) {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  });
+  auto releaser = store.SubmitAndGetFuture([&released] { released = true; });
+  releaser.get();
+  waiter.get();
+  EXPECT_EQ(pool.NumThreads(), 2);
+}
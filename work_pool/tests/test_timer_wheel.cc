@@ -0,0 +1,256 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+#include "work_pool/lock_free_mpmc.h"
+#include "work_pool/thread_pool.h"
+#include "work_pool/timer_wheel.h"
+
+using work_pool::TimerWheel;
+using Clock = TimerWheel::Clock;
+using std::chrono::milliseconds;
+
+namespace {
+
+// Advances `wheel` to `now` and runs whatever became due.
+int AdvanceAndRun(TimerWheel &wheel, const Clock::time_point now) {
+  std::vector<work_pool::Task> due;
+  EXPECT_TRUE(wheel.TryAdvance(now, due));
+  for (auto &task : due) {
+    task();
+  }
+  return static_cast<int>(due.size());
+}
+
+} // namespace
+
+TEST(TimerWheelTest, FiresOnItsTickAcrossLevels) {
+  const auto origin = Clock::now();
+  TimerWheel wheel(milliseconds(1), origin);
+  const std::vector<int64_t> ticks = {1,     2,     5,     255,   256,
+                                      257,   1000,  65535, 65536, 65537,
+                                      70000, 1 << 24, (1 << 24) + 3};
+  std::vector<int64_t> fired;
+  // Inserted in reverse so insertion order does not match firing order.
+  for (auto it = ticks.rbegin(); it != ticks.rend(); ++it) {
+    const int64_t tick = *it;
+    wheel.Add(origin + milliseconds(tick),
+              work_pool::Task([&fired, tick] { fired.push_back(tick); }));
+  }
+  EXPECT_EQ(wheel.Size(), ticks.size());
+
+  for (const int64_t tick : ticks) {
+    EXPECT_LE(wheel.NextDue(), origin + milliseconds(tick));
+    EXPECT_EQ(AdvanceAndRun(wheel, origin + milliseconds(tick - 1)), 0)
+        << tick;
+    EXPECT_EQ(AdvanceAndRun(wheel, origin + milliseconds(tick)), 1) << tick;
+  }
+  EXPECT_EQ(fired, ticks);
+  EXPECT_TRUE(wheel.Empty());
+  EXPECT_EQ(wheel.NextDue(), Clock::time_point::max());
+}
+
+TEST(TimerWheelTest, FarTimersWaitInTopLevel) {
+  const auto origin = Clock::now();
+  TimerWheel wheel(milliseconds(1), origin);
+  // Beyond the 2^32 ticks the levels span.
+  const auto id = wheel.Add(origin + milliseconds(int64_t{1} << 33),
+                            work_pool::Task([] { FAIL(); }));
+  EXPECT_EQ(AdvanceAndRun(wheel, origin + milliseconds((1 << 24) + 1)), 0);
+  EXPECT_EQ(wheel.Size(), 1);
+  EXPECT_TRUE(wheel.Cancel(id));
+}
+
+TEST(TimerWheelTest, RoundsUpAndFiresOverdueTimersNext) {
+  const auto origin = Clock::now();
+  TimerWheel wheel(milliseconds(10), origin);
+  int fired = 0;
+  wheel.Add(origin + milliseconds(15), work_pool::Task([&fired] { ++fired; }));
+  EXPECT_EQ(AdvanceAndRun(wheel, origin + milliseconds(19)), 0);
+  EXPECT_EQ(AdvanceAndRun(wheel, origin + milliseconds(20)), 1);
+
+  AdvanceAndRun(wheel, origin + milliseconds(100));
+  wheel.Add(origin, work_pool::Task([&fired] { ++fired; }));
+  EXPECT_EQ(AdvanceAndRun(wheel, origin + milliseconds(109)), 0);
+  EXPECT_EQ(AdvanceAndRun(wheel, origin + milliseconds(110)), 1);
+  EXPECT_EQ(fired, 2);
+}
+
+TEST(TimerWheelTest, Cancel) {
+  const auto origin = Clock::now();
+  TimerWheel wheel(milliseconds(1), origin);
+  int fired = 0;
+  const auto cancelled =
+      wheel.Add(origin + milliseconds(300), work_pool::Task([&] { ++fired; }));
+  const auto kept =
+      wheel.Add(origin + milliseconds(300), work_pool::Task([&] { ++fired; }));
+  EXPECT_TRUE(wheel.Cancel(cancelled));
+  EXPECT_FALSE(wheel.Cancel(cancelled));
+  EXPECT_EQ(AdvanceAndRun(wheel, origin + milliseconds(1000)), 1);
+  EXPECT_EQ(fired, 1);
+  EXPECT_FALSE(wheel.Cancel(kept));
+}
+
+TEST(TimerWheelTest, PeriodicDoesNotDrift) {
+  const auto origin = Clock::now();
+  TimerWheel wheel(milliseconds(1), origin);
+  int fired = 0;
+  const auto id = wheel.AddPeriodic(origin + milliseconds(10), milliseconds(10),
+                                    [&fired] { ++fired; });
+  EXPECT_EQ(AdvanceAndRun(wheel, origin + milliseconds(35)), 3);
+  // Catching up late fires once per elapsed period.
+  EXPECT_EQ(AdvanceAndRun(wheel, origin + milliseconds(70)), 4);
+  EXPECT_EQ(fired, 7);
+  EXPECT_TRUE(wheel.Cancel(id));
+  EXPECT_EQ(AdvanceAndRun(wheel, origin + milliseconds(200)), 0);
+}
+
+TEST(TimerWheelTest, ManyTimers) {
+  constexpr int kTimers = 200000;
+  const auto origin = Clock::now();
+  TimerWheel wheel(milliseconds(1), origin);
+  int fired = 0;
+  std::vector<TimerWheel::TimerId> ids;
+  for (int i = 0; i < kTimers; ++i) {
+    ids.push_back(wheel.Add(origin + milliseconds(1 + i % 100000),
+                            work_pool::Task([&fired] { ++fired; })));
+  }
+  // Cancel every other one.
+  for (int i = 0; i < kTimers; i += 2) {
+    EXPECT_TRUE(wheel.Cancel(ids[i]));
+  }
+  EXPECT_EQ(AdvanceAndRun(wheel, origin + milliseconds(100000)), kTimers / 2);
+  EXPECT_EQ(fired, kTimers / 2);
+}
+
+/**
+ * Delayed tasks run on an otherwise idle pool, so the parked timekeeper
+ * wakes up for them, and never before their time.
+ */
+TEST(ThreadPoolTimerTest, SubmitAfterAndAt) {
+  work_pool::MPMCTaskStore store;
+  work_pool::ThreadPool pool(store, 2);
+  pool.Start();
+  // Let the workers park.
+  std::this_thread::sleep_for(milliseconds(20));
+
+  const auto start = Clock::now();
+  std::atomic<int64_t> after_ns{0};
+  std::atomic<int64_t> at_ns{0};
+  pool.SubmitAfter(milliseconds(30), [&] {
+    after_ns = std::chrono::nanoseconds(Clock::now() - start).count();
+  });
+  pool.SubmitAt(start + milliseconds(10), [&] {
+    at_ns = std::chrono::nanoseconds(Clock::now() - start).count();
+  });
+  const auto cancelled = pool.SubmitAfter(milliseconds(20), [] { FAIL(); });
+  EXPECT_EQ(pool.PendingTimers(), 3);
+  EXPECT_TRUE(pool.CancelTimer(cancelled));
+
+  const auto deadline = start + std::chrono::seconds(10);
+  while ((after_ns == 0 || at_ns == 0) && Clock::now() < deadline) {
+    std::this_thread::sleep_for(milliseconds(1));
+  }
+  EXPECT_GE(after_ns.load(), 30'000'000);
+  EXPECT_GE(at_ns.load(), 10'000'000);
+  EXPECT_EQ(pool.PendingTimers(), 0);
+}
+
+TEST(ThreadPoolTimerTest, SubmitEvery) {
+  work_pool::MPMCTaskStore store;
+  work_pool::ThreadPool pool(store, 1);
+  pool.Start();
+  std::atomic<int> runs{0};
+  const auto id = pool.SubmitEvery(milliseconds(2), [&runs] { ++runs; });
+  const auto deadline = Clock::now() + std::chrono::seconds(10);
+  while (runs < 5 && Clock::now() < deadline) {
+    std::this_thread::sleep_for(milliseconds(1));
+  }
+  EXPECT_GE(runs.load(), 5);
+  EXPECT_TRUE(pool.CancelTimer(id));
+  // A run may already be queued; after that, nothing.
+  std::this_thread::sleep_for(milliseconds(10));
+  const int stopped_at = runs;
+  std::this_thread::sleep_for(milliseconds(20));
+  EXPECT_EQ(runs.load(), stopped_at);
+}
+
+/**
+ * Timers fire while every worker is busy with long tasks: workers advance
+ * the wheel between batches, not only when idle.
+ */
+TEST(ThreadPoolTimerTest, FiresWhileWorkersAreBusy) {
+  work_pool::MPMCTaskStore store;
+  work_pool::ThreadPool pool(store, 1);
+  pool.Start();
+  std::atomic<bool> fired{false};
+  std::atomic<bool> stop{false};
+  pool.SubmitAfter(milliseconds(5), [&fired] { fired = true; });
+  // Keep the only worker busy with a stream of short tasks.
+  const auto deadline = Clock::now() + std::chrono::seconds(10);
+  std::thread producer([&] {
+    while (!stop) {
+      store.Submit([] { std::this_thread::sleep_for(milliseconds(1)); },
+                   [] {});
+      std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+  });
+  while (!fired && Clock::now() < deadline) {
+    std::this_thread::sleep_for(milliseconds(1));
+  }
+  stop = true;
+  producer.join();
+  EXPECT_TRUE(fired.load());
+}
+
+/**
+ * The timekeeper is woken for a long task while the other workers sleep
+ * without a deadline. It must hand its role on, or the timer waits for the
+ * long task.
+ */
+TEST(ThreadPoolTimerTest, TimekeeperHandsOverWhenWoken) {
+  constexpr int kWorkers = 3;
+  work_pool::MPMCTaskStore store;
+  work_pool::ThreadPool pool(store, kWorkers);
+  pool.Start();
+
+  // Hold every worker in a task, then let them park one by one, so the
+  // first one to park becomes the timekeeper and is woken first.
+  std::atomic<int> started{0};
+  std::atomic<int> released{0};
+  for (int i = 0; i < kWorkers; ++i) {
+    store.Submit(
+        [&, i] {
+          ++started;
+          while (released <= i) {
+            std::this_thread::sleep_for(milliseconds(1));
+          }
+        },
+        [] {});
+    while (started <= i) {
+      std::this_thread::sleep_for(milliseconds(1));
+    }
+  }
+
+  const auto start = Clock::now();
+  std::atomic<int64_t> fired_ns{0};
+  pool.SubmitAt(start + milliseconds(300), [&] {
+    fired_ns = std::chrono::nanoseconds(Clock::now() - start).count();
+  });
+  for (int i = 1; i <= kWorkers; ++i) {
+    released = i;
+    std::this_thread::sleep_for(milliseconds(20));
+  }
+
+  store.Submit([] { std::this_thread::sleep_for(milliseconds(800)); },
+               [] {});
+  const auto deadline = start + std::chrono::seconds(10);
+  while (fired_ns == 0 && Clock::now() < deadline) {
+    std::this_thread::sleep_for(milliseconds(1));
+  }
+  EXPECT_GE(fired_ns.load(), 300'000'000);
+  EXPECT_LT(fired_ns.load(), 600'000'000);
+}
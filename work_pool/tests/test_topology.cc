@@ -0,0 +1,238 @@
+#include <sched.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <future>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "work_pool/lock_free_mpmc.h"
+#include "work_pool/numa_task_store.h"
+#include "work_pool/thread_pool.h"
+#include "work_pool/topology.h"
+
+using work_pool::Placement;
+using work_pool::Topology;
+
+namespace {
+
+constexpr char kTwoNodes[] = "work_pool/tests/testdata/two_nodes.topology";
+// Fake /sys/devices/system/node with nodes 0 (CPUs 0-1) and 2 (CPUs 4-5).
+constexpr char kSparseNodes[] = "work_pool/tests/testdata/sparse_nodes";
+// Same, without the "online" file.
+constexpr char kSparseNodesNoOnline[] =
+    "work_pool/tests/testdata/sparse_nodes_no_online";
+
+// Node 0: CPUs 0-3, node 1: CPUs 4-7.
+Topology TwoNodes() {
+  return Topology::FromNodes({{0, 1, 2, 3}, {4, 5, 6, 7}});
+}
+
+} // namespace
+
+TEST(TopologyTest, ParseCpuList) {
+  EXPECT_EQ(Topology::ParseCpuList("0-3,8,10-11\n"),
+            (std::vector<int>{0, 1, 2, 3, 8, 10, 11}));
+  EXPECT_EQ(Topology::ParseCpuList("5"), std::vector<int>{5});
+  EXPECT_TRUE(Topology::ParseCpuList("").empty());
+  EXPECT_THROW(Topology::ParseCpuList("0-x"), std::runtime_error);
+}
+
+TEST(TopologyTest, FromFile) {
+  const Topology topology = Topology::FromFile(kTwoNodes);
+  ASSERT_EQ(topology.NumNodes(), 2);
+  EXPECT_EQ(topology.CpusOfNode(0), (std::vector<int>{0, 1, 2, 3, 8}));
+  EXPECT_EQ(topology.CpusOfNode(1), (std::vector<int>{4, 5, 6, 7}));
+  EXPECT_EQ(topology.NumCpus(), 9);
+  EXPECT_EQ(topology.NodeOfCpu(8), 0);
+  EXPECT_EQ(topology.NodeOfCpu(5), 1);
+  EXPECT_EQ(topology.NodeOfCpu(42), -1);
+  EXPECT_THROW(Topology::FromFile("does/not/exist"), std::runtime_error);
+}
+
+TEST(TopologyTest, FromSysfsWithSparseNodeIds) {
+  for (const char *root : {kSparseNodes, kSparseNodesNoOnline}) {
+    const Topology topology = Topology::FromSysfs(root);
+    ASSERT_EQ(topology.NumNodes(), 2) << root;
+    EXPECT_EQ(topology.CpusOfNode(0), (std::vector<int>{0, 1})) << root;
+    EXPECT_EQ(topology.CpusOfNode(1), (std::vector<int>{4, 5})) << root;
+    EXPECT_EQ(topology.NodeOfCpu(5), 1) << root;
+  }
+  EXPECT_THROW(Topology::FromSysfs("does/not/exist"), std::runtime_error);
+}
+
+TEST(TopologyTest, DetectHonorsTopologyFile) {
+  setenv("WORK_POOL_TOPOLOGY_FILE", kTwoNodes, 1);
+  const Topology topology = Topology::Detect();
+  unsetenv("WORK_POOL_TOPOLOGY_FILE");
+  EXPECT_EQ(topology.NumNodes(), 2);
+}
+
+TEST(TopologyTest, DetectFindsAllowedCpus) {
+  const Topology topology = Topology::Detect();
+  ASSERT_GE(topology.NumNodes(), 1);
+  cpu_set_t set;
+  ASSERT_EQ(sched_getaffinity(0, sizeof(set), &set), 0);
+  EXPECT_EQ(topology.NumCpus(), static_cast<size_t>(CPU_COUNT(&set)));
+}
+
+TEST(TopologyTest, AssignCpus) {
+  const Topology topology = TwoNodes();
+  EXPECT_EQ(AssignCpus(topology, {Placement::Mode::kNone, {}}, 2),
+            (std::vector<int>{-1, -1}));
+  EXPECT_EQ(AssignCpus(topology, {Placement::Mode::kCompact, {}}, 5),
+            (std::vector<int>{0, 1, 2, 3, 4}));
+  EXPECT_EQ(AssignCpus(topology, {Placement::Mode::kScatter, {}}, 5),
+            (std::vector<int>{0, 4, 1, 5, 2}));
+  EXPECT_EQ(AssignCpus(topology, {Placement::Mode::kExplicit, {6, 2}}, 3),
+            (std::vector<int>{6, 2, 6}));
+  EXPECT_THROW(AssignCpus(topology, {Placement::Mode::kExplicit, {}}, 1),
+               std::runtime_error);
+}
+
+TEST(TopologyTest, PinCurrentThread) {
+  const Topology topology = Topology::Detect();
+  const int cpu = topology.CpusOfNode(0).front();
+  std::thread([cpu] {
+    EXPECT_TRUE(work_pool::PinCurrentThread(cpu));
+    EXPECT_EQ(sched_getcpu(), cpu);
+    EXPECT_FALSE(work_pool::PinCurrentThread(-1));
+  }).join();
+}
+
+/**
+ * An elastic pool that shrinks and grows again reuses the slots, and so the
+ * CPUs, of its retired workers. Every CPU is on its own fake node, so tasks
+ * can tell which slot their worker has.
+ */
+TEST(TopologyTest, ElasticPoolReusesWorkerSlots) {
+  constexpr int kMax = 4;
+  const Topology topology = Topology::FromNodes({{0}, {1}, {2}, {3}});
+  work_pool::MPMCTaskStore store;
+  work_pool::ThreadPool pool(
+      store, work_pool::ElasticPolicy{
+                 .min_threads = 2,
+                 .max_threads = kMax,
+                 .idle_timeout = std::chrono::milliseconds(20),
+                 .watchdog_interval = std::chrono::hours(1)});
+  pool.SetPlacement(topology, {Placement::Mode::kCompact, {}});
+  pool.Start();
+
+  for (int round = 0; round < 3; ++round) {
+    std::atomic<int> arrived{0};
+    std::atomic<int> seen[kMax] = {0, 0, 0, 0};
+    std::vector<std::future<void>> futures;
+    for (int i = 0; i < kMax; ++i) {
+      futures.push_back(store.SubmitAndGetFuture([&] {
+        work_pool::BlockingRegion blocking;
+        seen[topology.CurrentNode()].fetch_add(1);
+        arrived.fetch_add(1);
+        while (arrived.load() < kMax) {
+          std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+      }));
+    }
+    for (auto &future : futures) {
+      future.get();
+    }
+    for (int node = 0; node < kMax; ++node) {
+      EXPECT_EQ(seen[node].load(), 1) << "round " << round << " node " << node;
+    }
+
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (pool.NumThreads() > 2 &&
+           std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    ASSERT_EQ(pool.NumThreads(), 2);
+  }
+}
+
+TEST(NumaTaskStoreTest, DrainsLocalNodeFirst) {
+  work_pool::NumaTaskStore<work_pool::MPMCTaskStore> store(TwoNodes());
+  ASSERT_EQ(store.NumNodes(), 2);
+
+  std::vector<int> order;
+  store.OnNode(0).Enqueue(work_pool::Task([&order] { order.push_back(0); }));
+  store.OnNode(1).Enqueue(work_pool::Task([&order] { order.push_back(1); }));
+  EXPECT_EQ(store.SizeApproxOnNode(0), 1);
+  EXPECT_EQ(store.SizeApproxOnNode(1), 1);
+  EXPECT_EQ(store.SizeApprox(), 2);
+  EXPECT_THROW(store.OnNode(2), std::runtime_error);
+
+  std::thread([&store] {
+    Topology::SetCurrentNode(1);
+    work_pool::Task task;
+    // Local task first, then the one stolen from node 0.
+    while (store.TryDequeue(task)) {
+      task();
+      task.Reset();
+    }
+  }).join();
+  EXPECT_EQ(order, (std::vector<int>{1, 0}));
+}
+
+/**
+ * Submits to both nodes of a fake topology and lets a pool with workers
+ * placed across both nodes run everything. Workers of both nodes must have
+ * taken tasks of their own node.
+ */
+TEST(NumaTaskStoreTest, WorksWithPlacedThreadPool) {
+  // Split the CPUs we may actually use into two nodes. With a single usable
+  // CPU, node 1 gets one we may not use: its workers run unpinned, but still
+  // on node 1.
+  const Topology detected = Topology::Detect();
+  std::vector<int> cpus;
+  for (size_t node = 0; node < detected.NumNodes(); ++node) {
+    for (const int cpu : detected.CpusOfNode(node)) {
+      cpus.push_back(cpu);
+    }
+  }
+  std::sort(cpus.begin(), cpus.end());
+  std::vector<int> first(cpus.begin(), cpus.begin() + (cpus.size() + 1) / 2);
+  std::vector<int> second(cpus.begin() + first.size(), cpus.end());
+  if (second.empty()) {
+    second.push_back(cpus.back() + 1);
+  }
+  const Topology topology = Topology::FromNodes({first, second});
+
+  constexpr int kTasksPerRound = 1000;
+  std::atomic<int> done{0};
+  std::atomic<int> local[2] = {0, 0};
+  int submitted = 0;
+  work_pool::NumaTaskStore<work_pool::MPMCTaskStore> store(topology);
+  {
+    work_pool::ThreadPool pool(store, 4);
+    pool.SetPlacement(topology, {Placement::Mode::kScatter, {}});
+    pool.Start();
+    EXPECT_THROW(pool.SetPlacement(topology, {}), std::runtime_error);
+    // Workers of one node may drain both before the other node's workers
+    // get a CPU, so submit rounds until both nodes ran tasks of their own.
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while ((local[0].load() == 0 || local[1].load() == 0) &&
+           std::chrono::steady_clock::now() < deadline) {
+      std::vector<std::future<void>> futures;
+      for (int i = 0; i < kTasksPerRound; ++i, ++submitted) {
+        const int node = i % 2;
+        futures.push_back(store.OnNode(node).SubmitAndGetFuture([&, node] {
+          if (topology.CurrentNode() == node) {
+            local[node].fetch_add(1, std::memory_order_relaxed);
+          }
+          done.fetch_add(1, std::memory_order_relaxed);
+        }));
+      }
+      for (auto &future : futures) {
+        future.get();
+      }
+    }
+  }
+  EXPECT_EQ(done.load(), submitted);
+  EXPECT_GT(local[0].load(), 0);
+  EXPECT_GT(local[1].load(), 0);
+}
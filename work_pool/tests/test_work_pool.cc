@@ -1,6 +1,7 @@
 #include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <future>
 #include <gtest/gtest.h>
 #include <iostream>
 #include <stdexcept>
@@ -13,3 +14,70 @@ TEST(WorkPoolTest, BasicInitializationTest) {
   work_pool::WorkPool wp(8);
   EXPECT_EQ(wp.Capacity(), 8);
 }
+
+TEST(WorkPoolTest, SubmitAndGetFuture) {
+  work_pool::WorkPool wp(8, 2);
+  wp.Start();
+
+  auto future = wp.SubmitAndGetFuture([](int a, int b) { return a + b; }, 2, 40);
+  EXPECT_EQ(future.get(), 42);
+}
+
+TEST(WorkPoolTest, TasksInSameSlotRunInOrder) {
+  work_pool::WorkPool wp(4, 4);
+  wp.Start();
+
+  std::vector<int> order;
+  std::vector<std::future<void>> futures;
+  for (int i = 0; i < 100; ++i) {
+    auto promise = std::make_shared<std::promise<void>>();
+    futures.push_back(promise->get_future());
+    wp.EnqueueToSlot(1, work_pool::Task([&order, i, promise]() {
+                       order.push_back(i);
+                       promise->set_value();
+                     }));
+  }
+  for (auto &f : futures) {
+    f.get();
+  }
+
+  ASSERT_EQ(order.size(), 100);
+  EXPECT_TRUE(std::is_sorted(order.begin(), order.end()));
+}
+
+/**
+ * Many producers submit concurrently while the workers drain the slots. Every
+ * task must run exactly once.
+ */
+TEST(WorkPoolTest, MultiProducerAllTasksRun) {
+  const int kProducers = 4;
+  const int kTasksPerProducer = 1000;
+
+  std::atomic<int> executed(0);
+  {
+    work_pool::WorkPool wp(16, 4);
+    wp.Start();
+
+    std::vector<std::thread> producers;
+    std::vector<std::vector<std::future<void>>> futures(kProducers);
+    for (int p = 0; p < kProducers; ++p) {
+      producers.emplace_back([&wp, &executed, &futures, p]() {
+        for (int i = 0; i < kTasksPerProducer; ++i) {
+          futures[p].push_back(wp.SubmitAndGetFuture([&executed]() {
+            executed.fetch_add(1, std::memory_order_relaxed);
+          }));
+        }
+      });
+    }
+    for (auto &t : producers) {
+      t.join();
+    }
+    for (auto &fs : futures) {
+      for (auto &f : fs) {
+        f.get();
+      }
+    }
+  }
+
+  EXPECT_EQ(executed.load(), kProducers * kTasksPerProducer);
+}
@@ -0,0 +1,116 @@
+#include <atomic>
+#include <future>
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+#include "work_pool/chase_lev_deque.h"
+#include "work_pool/lock_free_mpmc.h"
+#include "work_pool/work_stealing_pool.h"
+
+TEST(ChaseLevDequeTest, OwnerIsLifoThiefIsFifo) {
+  work_pool::ChaseLevDeque<int> deque(2);
+  for (int i = 0; i < 10; ++i) {
+    deque.Push(i);
+  }
+  EXPECT_EQ(deque.SizeApprox(), 10);
+
+  EXPECT_EQ(deque.Pop(), 9);
+  EXPECT_EQ(deque.Steal(), 0);
+  EXPECT_EQ(deque.Pop(), 8);
+  EXPECT_EQ(deque.Steal(), 1);
+
+  while (deque.Pop()) {
+  }
+  EXPECT_EQ(deque.Pop(), std::nullopt);
+  EXPECT_EQ(deque.Steal(), std::nullopt);
+}
+
+/**
+ * The owner pushes and pops while thieves steal. Every item must come out
+ * exactly once.
+ */
+TEST(ChaseLevDequeTest, ConcurrentStealTakesEachItemOnce) {
+  const int kItems = 100000;
+  const int kThieves = 3;
+
+  work_pool::ChaseLevDeque<int> deque(4);
+  std::vector<std::atomic<int>> seen(kItems);
+  std::atomic<bool> done(false);
+
+  std::vector<std::thread> thieves;
+  for (int t = 0; t < kThieves; ++t) {
+    thieves.emplace_back([&]() {
+      while (!done.load()) {
+        if (auto item = deque.Steal()) {
+          seen[*item].fetch_add(1);
+        }
+      }
+    });
+  }
+
+  for (int i = 0; i < kItems; ++i) {
+    deque.Push(i);
+    if (i % 3 == 0) {
+      if (auto item = deque.Pop()) {
+        seen[*item].fetch_add(1);
+      }
+    }
+  }
+  while (auto item = deque.Pop()) {
+    seen[*item].fetch_add(1);
+  }
+  done.store(true);
+  for (auto &t : thieves) {
+    t.join();
+  }
+
+  for (int i = 0; i < kItems; ++i) {
+    ASSERT_EQ(seen[i].load(), 1) << "item " << i;
+  }
+}
+
+TEST(WorkStealingThreadPoolTest, ExternalSubmit) {
+  work_pool::MPMCTaskStore injection;
+  work_pool::WorkStealingThreadPool<work_pool::MPMCTaskStore> pool(injection,
+                                                                   4);
+  pool.Start();
+
+  auto future = pool.SubmitAndGetFuture([](int a, int b) { return a + b; },
+                                        2, 40);
+  EXPECT_EQ(future.get(), 42);
+}
+
+/**
+ * Divide-and-conquer: every task splits its range in two and submits the
+ * halves from inside the pool, so they land on the worker deques.
+ */
+TEST(WorkStealingThreadPoolTest, RecursiveSubmit) {
+  using Pool = work_pool::WorkStealingThreadPool<work_pool::MPMCTaskStore>;
+  const int kLeaves = 1 << 14;
+
+  work_pool::MPMCTaskStore injection;
+  Pool pool(injection, 4);
+  pool.Start();
+
+  std::atomic<int> sum(0);
+  std::atomic<int> remaining(kLeaves);
+  std::promise<void> done;
+
+  std::function<void(int, int)> split = [&](int begin, int end) {
+    if (end - begin == 1) {
+      sum.fetch_add(begin, std::memory_order_relaxed);
+      if (remaining.fetch_sub(1) == 1) {
+        done.set_value();
+      }
+      return;
+    }
+    const int mid = begin + (end - begin) / 2;
+    pool.Submit(split, [] {}, mid, end);
+    split(begin, mid);
+  };
+  pool.Submit(split, [] {}, 0, kLeaves);
+
+  done.get_future().get();
+  EXPECT_EQ(sum.load(), kLeaves * (kLeaves - 1) / 2);
+}
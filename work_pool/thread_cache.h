@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+
+namespace work_pool {
+
+// Small per-thread map from a store's process-unique id to per-producer
+// state of that store (a producer token, a lane index, ...).
+//
+// Each thread keeps the last kWays stores it used, so a thread that
+// alternates between a few stores never leaves the thread-local fast path.
+// Values are destroyed when their entry is evicted or the thread exits,
+// which lets them hand back whatever the store gave out. Ids must never be
+// reused, so an entry of a destroyed store is simply never matched again.
+template <class Value, size_t kWays = 4> class ThreadCache {
+public:
+  // Returns the calling thread's value for store `id`, constructing it from
+  // `args` on a miss.
+  template <class... Args>
+  static Value &Get(const uint64_t id, Args &&...args) {
+    Entries &entries = Local();
+    for (auto &entry : entries.slots) {
+      if (entry.id == id) {
+        return *entry.value;
+      }
+    }
+    // Round-robin replacement; the evicted value is destroyed first.
+    Entry &entry = entries.slots[entries.next++ % kWays];
+    entry.id = 0;
+    entry.value.reset();
+    entry.value.emplace(std::forward<Args>(args)...);
+    entry.id = id;
+    return *entry.value;
+  }
+
+private:
+  struct Entry {
+    uint64_t id = 0;
+    std::optional<Value> value;
+  };
+
+  struct Entries {
+    Entry slots[kWays];
+    size_t next = 0;
+  };
+
+  static Entries &Local() {
+    thread_local Entries entries;
+    return entries;
+  }
+};
+
+} // namespace work_pool
@@ -1,32 +1,243 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <thread>
+#include <utility>
 #include <vector>
 
+#include "metrics/metrics.h"
+#include "work_pool/coroutine.h"
+#include "work_pool/idle_policy.h"
 #include "work_pool/task_store.h"
+#include "work_pool/timer_wheel.h"
+#include "work_pool/topology.h"
 
 namespace work_pool {
 
+// Worker count bounds of an elastic ThreadPool.
+//
+// The pool starts `min_threads` workers. A watchdog thread checks the store
+// every `watchdog_interval` and adds a worker (up to `max_threads`) when no
+// worker is idle and either the queue holds at least
+// `queue_depth_per_worker` tasks per worker or some worker has been stuck in
+// one task since the last check. A BlockingRegion adds one right away. Extra
+// workers retire after `idle_timeout` without work.
+struct ElasticPolicy {
+  size_t min_threads = 1;
+  size_t max_threads = std::thread::hardware_concurrency();
+  std::chrono::milliseconds idle_timeout{1000};
+  std::chrono::milliseconds watchdog_interval{10};
+  size_t queue_depth_per_worker = 4;
+};
+
+namespace internal {
+
+// Lets a BlockingRegion reach the pool of the worker it runs on without
+// knowing the pool's type.
+struct BlockingHook {
+  void *worker = nullptr;
+  void (*enter)(void *worker) = nullptr;
+  void (*exit)(void *worker) = nullptr;
+};
+
+inline thread_local BlockingHook current_blocking_hook;
+
+} // namespace internal
+
+// Tells the pool the current task is about to block (on I/O, a lock, a
+// future of another pool, ...) for its lifetime:
+//
+//   {
+//     work_pool::BlockingRegion blocking;
+//     response = socket.Read();
+//   }
+//
+// The worker hands the rest of its dequeued batch back to the store, and an
+// elastic ThreadPool starts a compensating worker if none is idle, so the
+// blocked worker does not starve the queue. Outside a pool worker this does
+// nothing.
+class BlockingRegion {
+public:
+  BlockingRegion() : hook_(internal::current_blocking_hook) {
+    if (hook_.worker != nullptr) {
+      hook_.enter(hook_.worker);
+    }
+  }
+
+  ~BlockingRegion() {
+    if (hook_.worker != nullptr) {
+      hook_.exit(hook_.worker);
+    }
+  }
+
+  BlockingRegion(const BlockingRegion &) = delete;
+  BlockingRegion &operator=(const BlockingRegion &) = delete;
+
+private:
+  const internal::BlockingHook hook_;
+};
+
+// Pool of workers draining a TaskStore.
+//
+// An idle worker spins, then yields, then parks on the store's event count as
+// configured by `IdlePolicy`. Spinning workers pick up new tasks without a
+// syscall; parked ones are woken by the producer, and all of them at once on
+// shutdown.
+//
+// Workers take up to kMaxBatch tasks per dequeue, but no more than their fair
+// share of the queue, so a burst is not hoarded by the first worker to wake.
+//
+// The pool has a fixed number of workers unless constructed with an
+// ElasticPolicy, in which case it grows and shrinks within its bounds.
+//
+// SetPlacement() pins workers to CPUs; pinned workers also record their NUMA
+// node for stores such as NumaTaskStore.
+//
+// SubmitAfter(), SubmitAt() and SubmitEvery() keep delayed tasks in a
+// TimerWheel that the workers advance themselves: between batches, and from
+// the idle loop, where one parked worker (the timekeeper) sleeps no longer
+// than the next timer. There is no timer thread.
 template <class TaskStore> class ThreadPool {
   using Task = typename TaskStore::Task;
 
 public:
+  // Maximum number of tasks a worker takes from the store at once.
+  static constexpr size_t kMaxBatch = 16;
+
   explicit ThreadPool(TaskStore &task_store,
-                      size_t num_threads = std::thread::hardware_concurrency())
-      : task_store_(task_store), num_threads_(num_threads), done_(false) {}
+                      size_t num_threads = std::thread::hardware_concurrency(),
+                      const IdlePolicy &idle_policy = IdlePolicy())
+      : ThreadPool(task_store, FixedSize(num_threads), idle_policy) {}
+
+  ThreadPool(TaskStore &task_store, const ElasticPolicy &elastic_policy,
+             const IdlePolicy &idle_policy = IdlePolicy())
+      : task_store_(task_store), elastic_policy_(elastic_policy),
+        idle_policy_(idle_policy), done_(false) {
+    if (elastic_policy_.min_threads == 0 ||
+        elastic_policy_.max_threads < elastic_policy_.min_threads) {
+      throw std::runtime_error("Invalid ThreadPool size bounds!");
+    }
+  }
+
+  // Pins the workers according to `placement` once started. Must be called
+  // before Start().
+  void SetPlacement(const Topology &topology, const Placement &placement) {
+    if (started_) {
+      throw std::runtime_error("SetPlacement() called after Start()!");
+    }
+    cpus_ = AssignCpus(topology, placement, elastic_policy_.max_threads);
+    nodes_.clear();
+    for (const int cpu : cpus_) {
+      nodes_.push_back(cpu >= 0 ? topology.NodeOfCpu(cpu) : -1);
+    }
+  }
 
   void Start() {
-    for (std::size_t i = 0; i < num_threads_; ++i)
-      workers_.emplace_back([this] { Loop(); });
+    started_ = true;
+    for (std::size_t i = 0; i < elastic_policy_.min_threads; ++i) {
+      AddWorker();
+    }
+    if (IsElastic()) {
+      watchdog_ = std::thread([this] { Watchdog(); });
+    }
   }
 
+  // The store this pool drains.
+  TaskStore &Store() { return task_store_; }
+
+  // Submits `func` to the store once `delay` has passed. The id can be
+  // passed to CancelTimer() until then.
+  template <typename FuncType>
+  TimerWheel::TimerId SubmitAfter(const TimerWheel::Clock::duration delay,
+                                  FuncType &&func) {
+    return SubmitAt(TimerWheel::Clock::now() + delay,
+                    std::forward<FuncType>(func));
+  }
+
+  // Submits `func` to the store at `when`.
+  template <typename FuncType>
+  TimerWheel::TimerId SubmitAt(const TimerWheel::Clock::time_point when,
+                               FuncType &&func) {
+    const TimerWheel::TimerId id =
+        timers_.Add(when, Task(std::forward<FuncType>(func)));
+    OnTimerAdded(when);
+    return id;
+  }
+
+  // Submits `func` to the store every `period`, starting one period from
+  // now, until CancelTimer(). Runs may overlap if `func` takes longer than
+  // the period.
+  TimerWheel::TimerId SubmitEvery(const TimerWheel::Clock::duration period,
+                                  std::function<void()> func) {
+    const auto first = TimerWheel::Clock::now() + period;
+    const TimerWheel::TimerId id =
+        timers_.AddPeriodic(first, period, std::move(func));
+    OnTimerAdded(first);
+    return id;
+  }
+
+  // Cancels a pending timer. Returns false if it already fired (one-shot)
+  // or was cancelled.
+  bool CancelTimer(const TimerWheel::TimerId id) { return timers_.Cancel(id); }
+
+  // Number of pending timers.
+  const size_t PendingTimers() const { return timers_.Size(); }
+
+  // Number of live worker threads.
+  const size_t NumThreads() const {
+    return live_.load(std::memory_order_relaxed);
+  }
+
+  // Frame allocator of coroutines created on this pool's workers. Frames
+  // must not outlive the pool.
+  coro::FrameAllocator &Frames() { return frames_; }
+
+#ifdef LFWP_ENABLE_METRICS
+  // Fraction of time spent running tasks rather than spinning or parked, per
+  // worker slot. A slot covers every worker that has held it, reaped ones
+  // included. Only in metrics builds.
+  std::vector<double> Utilization() {
+    std::lock_guard<std::mutex> lock(workers_mutex_);
+    std::vector<SlotTimes> times = retired_times_;
+    times.resize(used_slots_.size());
+    for (const auto &worker : workers_) {
+      times[worker->index].busy_ns +=
+          worker->busy_ns.load(std::memory_order_relaxed);
+      times[worker->index].idle_ns +=
+          worker->idle_ns.load(std::memory_order_relaxed);
+    }
+    std::vector<double> utilization;
+    for (const SlotTimes &slot : times) {
+      const double busy = static_cast<double>(slot.busy_ns);
+      const double idle = static_cast<double>(slot.idle_ns);
+      utilization.push_back(busy + idle > 0 ? busy / (busy + idle) : 0.0);
+    }
+    return utilization;
+  }
+#endif
+
   ~ThreadPool() {
-    done_ = true;
-    for (auto &thread : workers_) {
-      thread.join();
+    {
+      std::lock_guard<std::mutex> lock(workers_mutex_);
+      done_.store(true, std::memory_order_seq_cst);
+    }
+    watchdog_cv_.notify_all();
+    if (watchdog_.joinable()) {
+      watchdog_.join();
+    }
+    task_store_.Idle().NotifyAll();
+    // No worker is added once done_ is set, so the list is final.
+    for (auto &worker : workers_) {
+      worker->thread.join();
     }
   }
 
@@ -34,21 +245,375 @@ public:
   ThreadPool &operator=(const ThreadPool &) = delete;
 
 private:
-  void Loop() {
-    std::shared_ptr<Task> task;
-    while (!done_) {
-      // TODO: Rework this logic.
-      if (task_store_.WaitDequeueTimed(task, std::chrono::milliseconds(10)) &&
-          task && task->exec) {
-        task->exec();
+  struct alignas(64) Worker {
+    Worker(ThreadPool *pool, const size_t index) : pool(pool), index(index) {}
+
+    ThreadPool *pool;
+    // Slot of the worker, which picks its CPU. Reused once the worker is
+    // reaped.
+    const size_t index;
+    std::thread thread;
+    // Tasks of the current batch not started yet; owning thread only.
+    Task *batch = nullptr;
+    size_t batch_next = 0;
+    size_t batch_end = 0;
+    // Tasks run so far, sampled by the watchdog to find stuck workers.
+    std::atomic<uint64_t> progress{0};
+    std::atomic<bool> idle{false};
+    std::atomic<bool> exited{false};
+    // Progress at the previous watchdog check; watchdog only.
+    uint64_t last_progress = 0;
+#ifdef LFWP_ENABLE_METRICS
+    std::atomic<uint64_t> busy_ns{0};
+    std::atomic<uint64_t> idle_ns{0};
+#endif
+  };
+
+#ifdef LFWP_ENABLE_METRICS
+  struct SlotTimes {
+    uint64_t busy_ns = 0;
+    uint64_t idle_ns = 0;
+  };
+#endif
+
+  static ElasticPolicy FixedSize(const size_t num_threads) {
+    ElasticPolicy policy;
+    policy.min_threads = policy.max_threads = std::max<size_t>(num_threads, 1);
+    return policy;
+  }
+
+  const bool IsElastic() const {
+    return elastic_policy_.max_threads > elastic_policy_.min_threads;
+  }
+
+  // Starts a worker unless the pool is at its maximum or shutting down.
+  void AddWorker() {
+    std::lock_guard<std::mutex> lock(workers_mutex_);
+    if (done_.load(std::memory_order_relaxed) ||
+        live_.load(std::memory_order_relaxed) >= elastic_policy_.max_threads) {
+      return;
+    }
+    // Reap workers that retired and free their slots.
+    std::erase_if(workers_, [this](const std::unique_ptr<Worker> &worker) {
+      if (!worker->exited.load(std::memory_order_acquire)) {
+        return false;
+      }
+      worker->thread.join();
+      used_slots_[worker->index] = false;
+#ifdef LFWP_ENABLE_METRICS
+      // Keep the time of the reaped worker for Utilization().
+      if (retired_times_.size() <= worker->index) {
+        retired_times_.resize(worker->index + 1);
+      }
+      retired_times_[worker->index].busy_ns +=
+          worker->busy_ns.load(std::memory_order_relaxed);
+      retired_times_[worker->index].idle_ns +=
+          worker->idle_ns.load(std::memory_order_relaxed);
+#endif
+      return true;
+    });
+    // The lowest free slot, so a pool that shrank and grew again fills the
+    // CPUs of the retired workers instead of doubling up on the first ones.
+    const size_t index = static_cast<size_t>(
+        std::find(used_slots_.begin(), used_slots_.end(), false) -
+        used_slots_.begin());
+    if (index == used_slots_.size()) {
+      used_slots_.push_back(true);
+    } else {
+      used_slots_[index] = true;
+    }
+    live_.fetch_add(1, std::memory_order_relaxed);
+    LFWP_METRIC_COUNT("thread_pool.workers_added", 1);
+    auto worker = std::make_unique<Worker>(this, index);
+    Worker *self = worker.get();
+    self->thread = std::thread([this, self] { Loop(*self); });
+    workers_.push_back(std::move(worker));
+  }
+
+  // Retires the calling worker if the pool has more than its minimum, not
+  // counting workers inside a BlockingRegion.
+  bool TryRetire() {
+    size_t live = live_.load(std::memory_order_relaxed);
+    while (live > elastic_policy_.min_threads +
+                      blocked_.load(std::memory_order_relaxed)) {
+      if (live_.compare_exchange_weak(live, live - 1,
+                                      std::memory_order_relaxed)) {
+        LFWP_METRIC_COUNT("thread_pool.workers_retired", 1);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Runs on the worker itself, in the middle of one of its batch's tasks.
+  static void EnterBlocking(void *worker) {
+    Worker &self = *static_cast<Worker *>(worker);
+    ThreadPool &pool = *self.pool;
+    if (self.batch_next < self.batch_end) {
+      pool.task_store_.EnqueueBulk(self.batch + self.batch_next,
+                                   self.batch_end - self.batch_next);
+      self.batch_end = self.batch_next;
+    }
+    pool.blocked_.fetch_add(1, std::memory_order_relaxed);
+    if (pool.idle_workers_.load(std::memory_order_relaxed) == 0) {
+      pool.AddWorker();
+    }
+  }
+
+  static void ExitBlocking(void *worker) {
+    static_cast<Worker *>(worker)->pool->blocked_.fetch_sub(
+        1, std::memory_order_relaxed);
+  }
+
+  void Watchdog() {
+    std::unique_lock<std::mutex> lock(watchdog_mutex_);
+    const auto done = [this] { return done_.load(std::memory_order_relaxed); };
+    while (!watchdog_cv_.wait_for(lock, elastic_policy_.watchdog_interval,
+                                  done)) {
+      if (ShouldGrow()) {
+        AddWorker();
+      }
+    }
+  }
+
+  bool ShouldGrow() {
+    if (idle_workers_.load(std::memory_order_relaxed) > 0) {
+      return false;
+    }
+    const size_t depth = task_store_.SizeApprox();
+    if (depth == 0) {
+      return false;
+    }
+    bool stalled = false;
+    {
+      std::lock_guard<std::mutex> lock(workers_mutex_);
+      for (auto &worker : workers_) {
+        const uint64_t progress =
+            worker->progress.load(std::memory_order_relaxed);
+        stalled |= !worker->idle.load(std::memory_order_relaxed) &&
+                   !worker->exited.load(std::memory_order_relaxed) &&
+                   progress == worker->last_progress;
+        worker->last_progress = progress;
+      }
+    }
+    return stalled ||
+           depth >= NumThreads() * elastic_policy_.queue_depth_per_worker;
+  }
+
+  void Loop(Worker &self) {
+    const size_t index = self.index;
+    if (!cpus_.empty() && cpus_[index % cpus_.size()] >= 0) {
+      // A CPU outside the affinity mask is refused; the worker then simply
+      // runs unpinned.
+      PinCurrentThread(cpus_[index % cpus_.size()]);
+      Topology::SetCurrentNode(nodes_[index % nodes_.size()]);
+    }
+    internal::current_blocking_hook = {&self, &EnterBlocking, &ExitBlocking};
+    coro::FrameAllocator::Scope frames(frames_);
+    std::array<Task, kMaxBatch> batch;
+    self.batch = batch.data();
+    std::vector<Task> due_timers;
+    while (!done_.load(std::memory_order_relaxed)) {
+      FireTimers(due_timers);
+      size_t n = TryDequeue(batch.data());
+      if (n == 0) {
+        self.idle.store(true, std::memory_order_relaxed);
+        idle_workers_.fetch_add(1, std::memory_order_relaxed);
+#ifdef LFWP_ENABLE_METRICS
+        const uint64_t idle_start = metrics::NowNs();
+#endif
+        bool timed_out = false;
+        if (Spin(batch[0]) || Park(batch[0], timed_out)) {
+          n = 1;
+        }
+#ifdef LFWP_ENABLE_METRICS
+        self.idle_ns.fetch_add(metrics::NowNs() - idle_start,
+                               std::memory_order_relaxed);
+#endif
+        idle_workers_.fetch_sub(1, std::memory_order_relaxed);
+        self.idle.store(false, std::memory_order_relaxed);
+        if (timed_out && TryRetire()) {
+          break;
+        }
+      }
+      // A BlockingRegion may cut the batch short.
+      self.batch_end = n;
+      for (self.batch_next = 0; self.batch_next < self.batch_end;) {
+        Task &task = batch[self.batch_next++];
+#ifdef LFWP_ENABLE_METRICS
+        const uint64_t start = metrics::NowNs();
+        LFWP_METRIC_RECORD("thread_pool.task_wait_ns",
+                           start - std::min(start, task.EnqueueNs()));
+#endif
+        if (task) {
+          task();
+        }
+        task.Reset();
+#ifdef LFWP_ENABLE_METRICS
+        const uint64_t run_ns = metrics::NowNs() - start;
+        LFWP_METRIC_RECORD("thread_pool.task_run_ns", run_ns);
+        self.busy_ns.fetch_add(run_ns, std::memory_order_relaxed);
+#endif
+        self.progress.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    internal::current_blocking_hook = {};
+    self.exited.store(true, std::memory_order_release);
+  }
+
+  // Enqueues the tasks of due timers, unless another worker is at it.
+  void FireTimers(std::vector<Task> &due) {
+    if (timers_.Empty()) {
+      return;
+    }
+    const auto now = TimerWheel::Clock::now();
+    if (timers_.NextDue() > now || !timers_.TryAdvance(now, due) ||
+        due.empty()) {
+      return;
+    }
+    task_store_.EnqueueBulk(due.data(), due.size());
+    due.clear();
+  }
+
+  // Makes sure a worker will wake up for a timer due at `when`.
+  void OnTimerAdded(const TimerWheel::Clock::time_point when) {
+    if (timers_.NextDue() < when) {
+      // An earlier timer already bounds the timekeeper's sleep.
+      return;
+    }
+    if (timekeeper_.load(std::memory_order_seq_cst)) {
+      // The timekeeper sleeps too long now. It cannot be woken alone.
+      task_store_.Idle().NotifyAll();
+    } else {
+      // Whoever wakes up becomes the timekeeper on its way back to sleep.
+      task_store_.Idle().NotifyOne();
+    }
+  }
+
+  size_t TryDequeue(Task *batch) {
+    // An elastic pool sizes the share for its largest size, so a worker that
+    // stalls in one task holds back as few others as possible.
+    const size_t depth = task_store_.SizeApprox();
+    LFWP_METRIC_RECORD("thread_pool.queue_depth", depth);
+    const size_t share =
+        IsElastic() ? std::max<size_t>(depth / elastic_policy_.max_threads, 1)
+                    : depth / NumThreads() + 1;
+    return task_store_.TryDequeueBulk(batch, std::min(share, kMaxBatch));
+  }
+
+  // Polls the store for a bounded budget. Returns false without polling if
+  // enough workers are spinning already.
+  bool Spin(Task &task) {
+    IdleState &idle = task_store_.Idle();
+    if (!idle.TryStartSpinning(idle_policy_.max_spinning)) {
+      return false;
+    }
+    const uint32_t budget =
+        idle_policy_.spin_iterations + idle_policy_.yield_iterations;
+    for (uint32_t i = 0; i < budget; ++i) {
+      if (done_.load(std::memory_order_relaxed)) {
+        break;
+      }
+      if (i < idle_policy_.spin_iterations) {
+        CpuRelax();
+      } else {
+        std::this_thread::yield();
+      }
+      if (task_store_.TryDequeue(task)) {
+        LFWP_METRIC_COUNT("thread_pool.spin_hits", 1);
+        idle.StopSpinning(true);
+        return true;
       }
     }
+    idle.StopSpinning(false);
+    return false;
+  }
+
+  // Sleeps until a producer or the destructor notifies, on an elastic pool
+  // at most until the idle timeout passes (setting `timed_out`), and as the
+  // timekeeper at most until the next timer. Returns true if a task showed
+  // up while registering as a waiter.
+  bool Park(Task &task, bool &timed_out) {
+    using Clock = std::chrono::steady_clock;
+    EventCount &event = task_store_.Idle().Event();
+    const EventCount::Key key = event.PrepareWait();
+    if (task_store_.TryDequeue(task)) {
+      event.CancelWait();
+      return true;
+    }
+    if (done_.load(std::memory_order_seq_cst)) {
+      event.CancelWait();
+      return false;
+    }
+
+    const Clock::time_point now = Clock::now();
+    const Clock::time_point idle_deadline =
+        IsElastic() ? now + elastic_policy_.idle_timeout
+                    : Clock::time_point::max();
+    Clock::time_point deadline = idle_deadline;
+    // Claimed after PrepareWait() and before reading the next due time, so
+    // a timer added meanwhile either shows up here or notifies us.
+    const bool timekeeper =
+        !timers_.Empty() &&
+        !timekeeper_.exchange(true, std::memory_order_seq_cst);
+    if (timekeeper) {
+      deadline = std::min(deadline, timers_.NextDue());
+    }
+    bool notified = false;
+    if (deadline <= now) {
+      event.CancelWait();
+    } else {
+      LFWP_METRIC_COUNT("thread_pool.parks", 1);
+      if (deadline == Clock::time_point::max()) {
+        event.Wait(key);
+        notified = true;
+      } else {
+        notified = event.WaitUntil(key, deadline);
+      }
+    }
+    if (timekeeper) {
+      timekeeper_.store(false, std::memory_order_seq_cst);
+      if (notified && !timers_.Empty()) {
+        // Woken for a task that may keep us busy past the next timer. Wake
+        // another worker, which takes over on its way back to sleep.
+        task_store_.Idle().NotifyOne();
+      }
+    }
+    // A notified worker must not retire: the wakeup was meant for it.
+    timed_out = !notified && IsElastic() && Clock::now() >= idle_deadline;
+    return false;
   }
 
   TaskStore &task_store_;
-  std::vector<std::thread> workers_;
-  size_t num_threads_;
+  const ElasticPolicy elastic_policy_;
+  IdlePolicy idle_policy_;
+  // CPU and node of every worker, or empty if the workers are not pinned.
+  std::vector<int> cpus_;
+  std::vector<int> nodes_;
+  bool started_ = false;
+
+  std::mutex workers_mutex_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  // Slots of the workers in workers_.
+  std::vector<bool> used_slots_;
+#ifdef LFWP_ENABLE_METRICS
+  // Busy and idle time of the reaped workers, per slot.
+  std::vector<SlotTimes> retired_times_;
+#endif
+  std::atomic<size_t> live_{0};
+  std::atomic<size_t> idle_workers_{0};
+  std::atomic<size_t> blocked_{0};
+
+  std::thread watchdog_;
+  std::mutex watchdog_mutex_;
+  std::condition_variable watchdog_cv_;
+
+  TimerWheel timers_;
+  // Set while a parked worker sleeps until the next timer.
+  std::atomic<bool> timekeeper_{false};
+
   std::atomic<bool> done_{false};
+  coro::FrameAllocator frames_;
 };
 
-} // namespace work_pool
\ No newline at end of file
+} // namespace work_pool
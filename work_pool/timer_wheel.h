@@ -0,0 +1,330 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "work_pool/task.h"
+
+namespace work_pool {
+
+// Hierarchical timing wheel.
+//
+// Four levels of 256 slots; a slot on level l spans 256^l ticks. A timer goes
+// into the lowest level whose span still covers its delay and moves down a
+// level each time the wheel reaches its slot, so insert and cancel are O(1)
+// (an intrusive list per slot, plus a hash map from id to timer), and
+// advancing costs O(1) per elapsed tick and per timer. Delays beyond the top
+// level (2^32 ticks) park in the top level until they get closer.
+//
+// A mutex guards the wheel. Nothing drives it: owners call TryAdvance(), which
+// gives up at once if another thread is already advancing (ThreadPool does
+// this from its workers' idle loop).
+class TimerWheel {
+public:
+  using Clock = std::chrono::steady_clock;
+  using TimerId = uint64_t;
+
+  static constexpr int kLevels = 4;
+  static constexpr int kSlotBits = 8;
+  static constexpr size_t kSlots = size_t{1} << kSlotBits;
+
+  // Tick 0 is at `origin`; tick t covers [origin + (t - 1) * resolution,
+  // origin + t * resolution).
+  explicit TimerWheel(
+      const Clock::duration resolution = std::chrono::milliseconds(1),
+      const Clock::time_point origin = Clock::now())
+      : resolution_(resolution), origin_(origin) {
+    if (resolution_ <= Clock::duration::zero()) {
+      throw std::runtime_error("TimerWheel resolution must be positive!");
+    }
+  }
+
+  ~TimerWheel() {
+    for (auto &[id, timer] : timers_) {
+      delete timer;
+    }
+  }
+
+  // Schedules `task` to become due at `when` (rounded up to the next tick).
+  TimerId Add(const Clock::time_point when, Task task) {
+    auto *timer = new Timer();
+    timer->when = when;
+    timer->task = std::move(task);
+    return Insert(timer);
+  }
+
+  // Schedules `func` to become due at `first`, then every `period` after it.
+  // Firings do not drift: each one is scheduled from the previous one's due
+  // time, not from when it ran.
+  TimerId AddPeriodic(const Clock::time_point first,
+                      const Clock::duration period,
+                      std::function<void()> func) {
+    if (period <= Clock::duration::zero()) {
+      throw std::runtime_error("Timer period must be positive!");
+    }
+    auto *timer = new Timer();
+    timer->when = first;
+    timer->period = period;
+    timer->func = std::make_shared<std::function<void()>>(std::move(func));
+    return Insert(timer);
+  }
+
+  // Removes a pending timer; for a periodic one, all of its future firings.
+  // Returns false if the timer already fired (one-shot) or was cancelled.
+  bool Cancel(const TimerId id) {
+    Timer *timer;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      const auto it = timers_.find(id);
+      if (it == timers_.end()) {
+        return false;
+      }
+      timer = it->second;
+      timers_.erase(it);
+      Unlink(timer);
+      size_.store(timers_.size(), std::memory_order_relaxed);
+    }
+    delete timer;
+    return true;
+  }
+
+  // Advances the wheel to `now` and appends the tasks of every timer that
+  // became due to `due`. Returns false without advancing if another thread
+  // holds the wheel.
+  bool TryAdvance(const Clock::time_point now, std::vector<Task> &due) {
+    std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+    if (!lock.owns_lock()) {
+      return false;
+    }
+    const uint64_t target = TickOf(now, /*round_up=*/false);
+    if (timers_.empty()) {
+      current_tick_ = std::max(current_tick_, target);
+    }
+    while (current_tick_ < target) {
+      ProcessTick(current_tick_ + 1, due);
+    }
+    size_.store(timers_.size(), std::memory_order_relaxed);
+    next_due_.store(NextDueTickLocked(), std::memory_order_seq_cst);
+    return true;
+  }
+
+  // Earliest time the wheel may have something due: a lower bound, so
+  // advancing then can find nothing to do. Clock::time_point::max() if no
+  // timer is pending.
+  Clock::time_point NextDue() const {
+    const uint64_t tick = next_due_.load(std::memory_order_seq_cst);
+    if (tick == kNever) {
+      return Clock::time_point::max();
+    }
+    return origin_ + resolution_ * static_cast<int64_t>(tick);
+  }
+
+  // Number of pending timers.
+  size_t Size() const { return size_.load(std::memory_order_relaxed); }
+
+  const bool Empty() const { return Size() == 0; }
+
+  TimerWheel(const TimerWheel &) = delete;
+  TimerWheel &operator=(const TimerWheel &) = delete;
+
+private:
+  static constexpr uint64_t kNever = UINT64_MAX;
+
+  struct Timer {
+    Timer *prev = nullptr;
+    Timer *next = nullptr;
+    TimerId id = 0;
+    uint64_t tick = 0;
+    Clock::time_point when;
+    // One-shot timers carry a task, periodic ones a shared callable.
+    Task task;
+    Clock::duration period{};
+    std::shared_ptr<std::function<void()>> func;
+    // Where the timer is linked.
+    int level = 0;
+    size_t slot = 0;
+  };
+
+  struct Slot {
+    Timer *head = nullptr;
+  };
+
+  struct Level {
+    std::array<Slot, kSlots> slots;
+    // Bit s is set while slot s is not empty.
+    std::array<uint64_t, kSlots / 64> occupied{};
+  };
+
+  uint64_t TickOf(const Clock::time_point when, const bool round_up) const {
+    if (when <= origin_) {
+      return 0;
+    }
+    const auto elapsed = when - origin_;
+    uint64_t ticks = static_cast<uint64_t>(elapsed / resolution_);
+    if (round_up && elapsed % resolution_ != Clock::duration::zero()) {
+      ++ticks;
+    }
+    return ticks;
+  }
+
+  TimerId Insert(Timer *timer) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const TimerId id = timer->id = next_id_++;
+    timers_.emplace(id, timer);
+    Place(timer);
+    size_.store(timers_.size(), std::memory_order_relaxed);
+    if (timer->tick < next_due_.load(std::memory_order_relaxed)) {
+      next_due_.store(timer->tick, std::memory_order_seq_cst);
+    }
+    return id;
+  }
+
+  // Puts a timer into the slot for its due time, relative to the last
+  // processed tick. Timers already due fire on the next tick.
+  void Place(Timer *timer) {
+    timer->tick =
+        std::max(TickOf(timer->when, /*round_up=*/true), current_tick_ + 1);
+    PlaceAt(timer, current_tick_ + 1);
+  }
+
+  // Places `timer` for a wheel whose next tick to process (or cascade into
+  // lower levels) is `next`. Level l holds the timers that share next's
+  // 256^(l+1)-tick block but not its 256^l-tick one, in the slot of their
+  // own 256^l-tick block, which the wheel cascades when it gets there.
+  void PlaceAt(Timer *timer, const uint64_t next) {
+    const uint64_t tick = timer->tick;
+    for (int level = 0; level < kLevels; ++level) {
+      const int shift = kSlotBits * (level + 1);
+      if (tick >> shift == next >> shift) {
+        Link(timer, level, (tick >> (kSlotBits * level)) & (kSlots - 1));
+        return;
+      }
+    }
+    // Too far out: wait in the top-level slot the wheel reaches last, and
+    // get placed again from there.
+    const int top = kSlotBits * (kLevels - 1);
+    Link(timer, kLevels - 1, ((next >> top) + kSlots - 1) & (kSlots - 1));
+  }
+
+  void Link(Timer *timer, const int level, const size_t slot) {
+    Level &l = levels_[level];
+    timer->prev = nullptr;
+    timer->next = l.slots[slot].head;
+    if (timer->next != nullptr) {
+      timer->next->prev = timer;
+    }
+    l.slots[slot].head = timer;
+    l.occupied[slot / 64] |= uint64_t{1} << (slot % 64);
+    timer->level = level;
+    timer->slot = slot;
+  }
+
+  void Unlink(Timer *timer) {
+    const size_t slot = timer->slot;
+    Level &l = levels_[timer->level];
+    if (timer->prev != nullptr) {
+      timer->prev->next = timer->next;
+    } else {
+      l.slots[slot].head = timer->next;
+    }
+    if (timer->next != nullptr) {
+      timer->next->prev = timer->prev;
+    }
+    if (l.slots[slot].head == nullptr) {
+      l.occupied[slot / 64] &= ~(uint64_t{1} << (slot % 64));
+    }
+  }
+
+  // Takes every timer out of a slot.
+  Timer *Detach(const int level, const size_t slot) {
+    Level &l = levels_[level];
+    Timer *head = l.slots[slot].head;
+    l.slots[slot].head = nullptr;
+    l.occupied[slot / 64] &= ~(uint64_t{1} << (slot % 64));
+    return head;
+  }
+
+  // Moves the timers of `tick` down from higher levels, then fires those on
+  // level 0.
+  void ProcessTick(const uint64_t tick, std::vector<Task> &due) {
+    // Cascade: at every multiple of 256^l, the level-l slot that starts
+    // there moves down. Higher levels first, so a timer can drop several
+    // levels in one tick.
+    int top = 0;
+    while (top < kLevels - 1 &&
+           (tick & ((uint64_t{1} << (kSlotBits * (top + 1))) - 1)) == 0) {
+      ++top;
+    }
+    for (int level = top; level > 0; --level) {
+      const size_t slot = (tick >> (kSlotBits * level)) & (kSlots - 1);
+      for (Timer *timer = Detach(level, slot); timer != nullptr;) {
+        Timer *next = timer->next;
+        PlaceAt(timer, tick);
+        timer = next;
+      }
+    }
+    Timer *expired = Detach(0, tick & (kSlots - 1));
+    current_tick_ = tick;
+    while (expired != nullptr) {
+      Timer *timer = expired;
+      expired = timer->next;
+      if (timer->func) {
+        due.emplace_back([func = timer->func]() { (*func)(); });
+        timer->when += timer->period;
+        Place(timer);
+      } else {
+        due.push_back(std::move(timer->task));
+        timers_.erase(timer->id);
+        delete timer;
+      }
+    }
+  }
+
+  // Next tick at which level 0 holds a timer, or at which a higher level
+  // cascades into it, whichever comes first.
+  uint64_t NextDueTickLocked() const {
+    if (timers_.empty()) {
+      return kNever;
+    }
+    const Level &l = levels_[0];
+    // Level 0 only holds ticks of the current 256-tick block, at or after
+    // the next one.
+    const uint64_t next = current_tick_ + 1;
+    for (size_t slot = next & (kSlots - 1); slot < kSlots;
+         slot += 64 - slot % 64) {
+      const uint64_t bits = l.occupied[slot / 64] >> (slot % 64);
+      if (bits != 0) {
+        return next - (next & (kSlots - 1)) + slot +
+               static_cast<size_t>(std::countr_zero(bits));
+      }
+    }
+    // Nothing on level 0: the next cascade.
+    return (current_tick_ | (kSlots - 1)) + 1;
+  }
+
+  const Clock::duration resolution_;
+  const Clock::time_point origin_;
+
+  std::mutex mutex_;
+  std::array<Level, kLevels> levels_;
+  // Last tick processed; timers of later ticks are in the wheel.
+  uint64_t current_tick_ = 0;
+  TimerId next_id_ = 1;
+  std::unordered_map<TimerId, Timer *> timers_;
+
+  std::atomic<size_t> size_{0};
+  std::atomic<uint64_t> next_due_{kNever};
+};
+
+} // namespace work_pool
@@ -0,0 +1,252 @@
+#include <sched.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <pthread.h>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "work_pool/topology.h"
+
+namespace work_pool {
+
+namespace {
+
+thread_local int current_node = -1;
+
+std::vector<int> AllowedCpus() {
+  std::vector<int> cpus;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &set)) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+  return cpus;
+}
+
+// CPUs of every node under `root`, indexed by node id. Node ids may be
+// sparse (e.g. online = "0,2"), so they are listed rather than probed from 0
+// until one is missing; the gaps stay empty.
+std::vector<std::vector<int>> ReadSysfsNodes(const std::string &root) {
+  std::vector<int> ids;
+  std::ifstream online(root + "/online");
+  if (online) {
+    std::string list;
+    std::getline(online, list);
+    ids = Topology::ParseCpuList(list);
+  } else {
+    std::error_code error;
+    for (const auto &entry :
+         std::filesystem::directory_iterator(root, error)) {
+      const std::string name = entry.path().filename().string();
+      if (name.size() > 4 && name.compare(0, 4, "node") == 0 &&
+          std::all_of(name.begin() + 4, name.end(), ::isdigit)) {
+        ids.push_back(std::stoi(name.substr(4)));
+      }
+    }
+  }
+
+  std::vector<std::vector<int>> node_cpus;
+  for (const int node : ids) {
+    std::ifstream file(root + "/node" + std::to_string(node) + "/cpulist");
+    if (node < 0 || !file) {
+      continue;
+    }
+    std::string cpulist;
+    std::getline(file, cpulist);
+    if (node_cpus.size() <= static_cast<size_t>(node)) {
+      node_cpus.resize(node + 1);
+    }
+    node_cpus[node] = Topology::ParseCpuList(cpulist);
+  }
+  return node_cpus;
+}
+
+} // namespace
+
+std::vector<int> Topology::ParseCpuList(const std::string &list) {
+  std::vector<int> cpus;
+  std::stringstream stream(list);
+  std::string range;
+  while (std::getline(stream, range, ',')) {
+    range.erase(std::remove_if(range.begin(), range.end(), ::isspace),
+                range.end());
+    if (range.empty()) {
+      continue;
+    }
+    try {
+      const size_t dash = range.find('-');
+      if (dash == std::string::npos) {
+        cpus.push_back(std::stoi(range));
+      } else {
+        const int first = std::stoi(range.substr(0, dash));
+        const int last = std::stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; ++cpu) {
+          cpus.push_back(cpu);
+        }
+      }
+    } catch (const std::logic_error &) {
+      throw std::runtime_error("Invalid cpulist: " + list + "!");
+    }
+  }
+  return cpus;
+}
+
+Topology Topology::FromNodes(std::vector<std::vector<int>> node_cpus) {
+  // Drop empty nodes (e.g. memory-only nodes) so node ids stay dense.
+  node_cpus.erase(std::remove_if(node_cpus.begin(), node_cpus.end(),
+                                 [](const auto &cpus) { return cpus.empty(); }),
+                  node_cpus.end());
+  if (node_cpus.empty()) {
+    throw std::runtime_error("Topology has no CPUs!");
+  }
+  Topology topology;
+  topology.node_cpus_ = std::move(node_cpus);
+  return topology;
+}
+
+Topology Topology::FromFile(const std::string &path) {
+  std::ifstream file(path);
+  if (!file) {
+    throw std::runtime_error("Cannot open topology file " + path + "!");
+  }
+  std::vector<std::vector<int>> node_cpus;
+  std::string line;
+  while (std::getline(file, line)) {
+    std::stringstream stream(line);
+    int node;
+    std::string cpulist;
+    if (line.empty() || line[0] == '#' || !(stream >> node)) {
+      continue;
+    }
+    std::getline(stream, cpulist);
+    if (node < 0) {
+      throw std::runtime_error("Invalid node in topology file " + path + "!");
+    }
+    if (node_cpus.size() <= static_cast<size_t>(node)) {
+      node_cpus.resize(node + 1);
+    }
+    const auto cpus = ParseCpuList(cpulist);
+    node_cpus[node].insert(node_cpus[node].end(), cpus.begin(), cpus.end());
+  }
+  return FromNodes(std::move(node_cpus));
+}
+
+Topology Topology::FromSysfs(const std::string &root) {
+  return FromNodes(ReadSysfsNodes(root));
+}
+
+Topology Topology::Detect() {
+  if (const char *path = std::getenv("WORK_POOL_TOPOLOGY_FILE")) {
+    return FromFile(path);
+  }
+
+  const std::vector<int> allowed = AllowedCpus();
+  const auto is_allowed = [&allowed](const int cpu) {
+    return std::binary_search(allowed.begin(), allowed.end(), cpu);
+  };
+
+  std::vector<std::vector<int>> node_cpus =
+      ReadSysfsNodes("/sys/devices/system/node");
+  for (auto &cpus : node_cpus) {
+    cpus.erase(std::remove_if(cpus.begin(), cpus.end(),
+                              [&](const int cpu) { return !is_allowed(cpu); }),
+               cpus.end());
+  }
+
+  size_t found = 0;
+  for (const auto &cpus : node_cpus) {
+    found += cpus.size();
+  }
+  if (found == 0) {
+    node_cpus.assign(1, allowed);
+  }
+  return FromNodes(std::move(node_cpus));
+}
+
+const size_t Topology::NumCpus() const {
+  size_t total = 0;
+  for (const auto &cpus : node_cpus_) {
+    total += cpus.size();
+  }
+  return total;
+}
+
+const int Topology::NodeOfCpu(const int cpu) const {
+  for (size_t node = 0; node < node_cpus_.size(); ++node) {
+    const auto &cpus = node_cpus_[node];
+    if (std::find(cpus.begin(), cpus.end(), cpu) != cpus.end()) {
+      return static_cast<int>(node);
+    }
+  }
+  return -1;
+}
+
+const int Topology::CurrentNode() const {
+  if (current_node >= 0 && static_cast<size_t>(current_node) < NumNodes()) {
+    return current_node;
+  }
+  const int cpu = sched_getcpu();
+  const int node = cpu >= 0 ? NodeOfCpu(cpu) : -1;
+  return node >= 0 ? node : 0;
+}
+
+void Topology::SetCurrentNode(const int node) { current_node = node; }
+
+std::vector<int> AssignCpus(const Topology &topology,
+                            const Placement &placement,
+                            const size_t num_workers) {
+  std::vector<int> order;
+  switch (placement.mode) {
+  case Placement::Mode::kNone:
+    return std::vector<int>(num_workers, -1);
+  case Placement::Mode::kCompact:
+    for (size_t node = 0; node < topology.NumNodes(); ++node) {
+      const auto &cpus = topology.CpusOfNode(node);
+      order.insert(order.end(), cpus.begin(), cpus.end());
+    }
+    break;
+  case Placement::Mode::kScatter:
+    for (size_t i = 0; order.size() < topology.NumCpus(); ++i) {
+      for (size_t node = 0; node < topology.NumNodes(); ++node) {
+        const auto &cpus = topology.CpusOfNode(node);
+        if (i < cpus.size()) {
+          order.push_back(cpus[i]);
+        }
+      }
+    }
+    break;
+  case Placement::Mode::kExplicit:
+    if (placement.cpus.empty()) {
+      throw std::runtime_error("Explicit placement needs at least one CPU!");
+    }
+    order = placement.cpus;
+    break;
+  }
+
+  std::vector<int> assignment(num_workers);
+  for (size_t i = 0; i < num_workers; ++i) {
+    assignment[i] = order[i % order.size()];
+  }
+  return assignment;
+}
+
+const bool PinCurrentThread(const int cpu) {
+  if (cpu < 0 || cpu >= CPU_SETSIZE) {
+    return false;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+} // namespace work_pool
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace work_pool {
+
+// CPUs this process may run on, grouped by NUMA node.
+class Topology {
+public:
+  // Reads the nodes under /sys/devices/system/node (see FromSysfs()) and
+  // keeps the CPUs allowed by sched_getaffinity(). Without sysfs NUMA
+  // information every allowed CPU lands in node 0. If
+  // WORK_POOL_TOPOLOGY_FILE is set, that file is read instead (see
+  // FromFile()).
+  static Topology Detect();
+
+  // Reads a topology from a file with one "<node> <cpulist>" line per node,
+  // e.g. "0 0-3,8" and "1 4-7". Blank lines and lines starting with '#' are
+  // skipped. Lets tests fake a multi-node machine.
+  static Topology FromFile(const std::string &path);
+
+  // Reads <root>/node<N>/cpulist for every node listed in <root>/online, or
+  // for every node<N> directory if there is no such file. Node ids may have
+  // gaps; the nodes are renumbered densely like in FromNodes(). Lets tests
+  // fake the sysfs layout.
+  static Topology FromSysfs(const std::string &root);
+
+  // Builds a topology from explicit per-node CPU lists.
+  static Topology FromNodes(std::vector<std::vector<int>> node_cpus);
+
+  // Parses the kernel's cpulist format ("0-3,8,10-11").
+  static std::vector<int> ParseCpuList(const std::string &list);
+
+  const size_t NumNodes() const { return node_cpus_.size(); }
+
+  const size_t NumCpus() const;
+
+  const std::vector<int> &CpusOfNode(const size_t node) const {
+    return node_cpus_[node];
+  }
+
+  // Node of `cpu`, or -1 if the CPU is not part of this topology.
+  const int NodeOfCpu(const int cpu) const;
+
+  // Node the calling thread is on: the node recorded by SetCurrentNode(), or
+  // else the node of the CPU it is running on (0 if unknown).
+  const int CurrentNode() const;
+
+  // Records the node of the calling thread; pinned pool workers call this.
+  static void SetCurrentNode(const int node);
+
+private:
+  Topology() = default;
+
+  std::vector<std::vector<int>> node_cpus_;
+};
+
+// How pool workers are pinned to CPUs.
+struct Placement {
+  enum class Mode {
+    // No pinning.
+    kNone,
+    // Fill the CPUs of node 0 first, then node 1, ...
+    kCompact,
+    // Round-robin over the nodes.
+    kScatter,
+    // Worker i gets cpus[i % cpus.size()].
+    kExplicit,
+  };
+
+  Mode mode = Mode::kNone;
+  std::vector<int> cpus;
+};
+
+// CPU for each of `num_workers` workers (-1 for no pinning). Workers wrap
+// around when there are more workers than CPUs.
+std::vector<int> AssignCpus(const Topology &topology,
+                            const Placement &placement,
+                            const size_t num_workers);
+
+// Pins the calling thread to `cpu`. Returns false if the kernel refused.
+const bool PinCurrentThread(const int cpu);
+
+} // namespace work_pool
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "concurrentqueue.h"
+#include "lightweightsemaphore.h"
+#include "signal_tree/signal_tree.h"
+#include "work_pool/task_store.h"
+
+namespace work_pool {
+
+// Work pool scheduled through a SignalTree.
+//
+// Tasks are published into one of `capacity` slots, each owning its own task
+// queue. A leaf of the signal tree is free (1) while its slot has pending work
+// that no worker is processing, so the root counts the slots that are ready to
+// run. Workers acquire a ready slot near the one they processed last, drain a
+// bounded batch of tasks from it and Release() the leaf again if work remains.
+// Producers and workers therefore only meet on the slot they touch instead of
+// all hitting one shared queue.
+class WorkPool : public TaskStore<WorkPool> {
+public:
+  using Base = TaskStore<WorkPool>;
+  using Task = typename Base::Task;
+
+  // Maximum number of tasks a worker runs from a slot before handing it back.
+  static constexpr size_t kMaxBatch = 32;
+
+  explicit WorkPool(const size_t capacity,
+                    size_t num_threads = std::thread::hardware_concurrency())
+      : tree_(capacity), slots_(new Slot[capacity]), num_threads_(num_threads) {
+    // The signal tree starts with every leaf free; no slot has work yet, so
+    // take them all.
+    for (size_t i = 0; i < capacity; ++i) {
+      tree_.Acquire();
+    }
+  }
+
+  ~WorkPool() {
+    done_ = true;
+    ready_.signal(static_cast<ssize_t>(workers_.size()));
+    for (auto &thread : workers_) {
+      thread.join();
+    }
+  }
+
+  void Start() {
+    for (std::size_t i = 0; i < num_threads_; ++i)
+      workers_.emplace_back([this, i] { Loop(i); });
+  }
+
+  // Number of task slots.
+  const size_t Capacity() const { return tree_.Capacity(); }
+
+  // Publishes a task into a slot chosen round-robin per producer thread.
+  void EnqueueImpl(Task task) {
+    thread_local size_t next_slot =
+        std::hash<std::thread::id>{}(std::this_thread::get_id());
+    EnqueueToSlot(next_slot++ % Capacity(), std::move(task));
+  }
+
+  // Publishes a task into a specific slot. Tasks in the same slot run in
+  // submission order and never concurrently with each other.
+  void EnqueueToSlot(const size_t slot, Task task) {
+    Slot &s = slots_[slot];
+    s.queue.enqueue(std::move(task));
+    // Only the producer that makes the slot non-empty signals it; afterwards
+    // the slot is owned by whichever worker acquires it.
+    if (s.pending.fetch_add(1, std::memory_order_acq_rel) == 0) {
+      Signal(slot);
+    }
+  }
+
+  WorkPool(const WorkPool &) = delete;
+  WorkPool &operator=(const WorkPool &) = delete;
+
+private:
+  static constexpr auto kIdleTimeout = std::chrono::milliseconds(10);
+
+  struct alignas(64) Slot {
+    // Start with a single block; per-slot queues are expected to stay short.
+    moodycamel::ConcurrentQueue<Task> queue{32};
+    std::atomic<int64_t> pending{0};
+  };
+
+  void Signal(const size_t slot) {
+    tree_.Release(static_cast<int>(slot));
+    ready_.signal();
+  }
+
+  void Loop(const size_t worker) {
+    Task task;
+    // Start from a home slot spread evenly over the tree and then stay near
+    // the last slot, so workers mostly stay on disjoint subtrees.
+    int hint = static_cast<int>(worker * Capacity() / num_threads_);
+    while (true) {
+      const int slot = tree_.AcquireNear(hint);
+      if (slot < 0) {
+        if (done_) {
+          return;
+        }
+        ready_.wait(std::chrono::duration_cast<std::chrono::microseconds>(
+                        kIdleTimeout)
+                        .count());
+        continue;
+      }
+      hint = slot;
+
+      Slot &s = slots_[slot];
+      int64_t executed = 0;
+      while (executed < static_cast<int64_t>(kMaxBatch) &&
+             s.queue.try_dequeue(task)) {
+        if (task) {
+          task();
+        }
+        task.Reset();
+        ++executed;
+      }
+
+      // Hand the slot back if producers added work while we held it.
+      if (s.pending.fetch_sub(executed, std::memory_order_acq_rel) - executed >
+          0) {
+        Signal(static_cast<size_t>(slot));
+      }
+    }
+  }
+
+  signal_tree::SignalTree tree_;
+  std::unique_ptr<Slot[]> slots_;
+  moodycamel::LightweightSemaphore ready_;
+  std::vector<std::thread> workers_;
+  size_t num_threads_;
+  std::atomic<bool> done_{false};
+};
+
+} // namespace work_pool
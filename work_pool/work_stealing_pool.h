@@ -0,0 +1,151 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "metrics/metrics.h"
+#include "work_pool/chase_lev_deque.h"
+#include "work_pool/task_store.h"
+
+namespace work_pool {
+
+// Work-stealing thread pool.
+//
+// Every worker owns a Chase-Lev deque. Tasks submitted from a worker thread
+// go to that worker's deque and are popped LIFO, so recursive and
+// divide-and-conquer workloads stay cache-local. Idle workers steal FIFO from
+// random victims. `InjectionStore` only carries tasks submitted from outside
+// the pool.
+template <class InjectionStore>
+class WorkStealingThreadPool
+    : public TaskStore<WorkStealingThreadPool<InjectionStore>> {
+public:
+  using Base = TaskStore<WorkStealingThreadPool<InjectionStore>>;
+  using Task = typename Base::Task;
+
+  explicit WorkStealingThreadPool(
+      InjectionStore &injection_store,
+      size_t num_threads = std::thread::hardware_concurrency())
+      : injection_store_(injection_store), num_threads_(num_threads) {}
+
+  void Start() {
+    // All deques exist before any worker can try to steal from them.
+    for (std::size_t i = 0; i < num_threads_; ++i) {
+      workers_.push_back(std::make_unique<Worker>(this, i));
+    }
+    for (auto &worker : workers_) {
+      Worker *self = worker.get();
+      self->thread = std::thread([this, self] { Loop(*self); });
+    }
+  }
+
+  ~WorkStealingThreadPool() {
+    done_ = true;
+    for (auto &worker : workers_) {
+      worker->thread.join();
+    }
+    // Tasks that never ran.
+    for (auto &worker : workers_) {
+      while (auto task = worker->deque.Pop()) {
+        delete *task;
+      }
+    }
+  }
+
+  // Tasks submitted from one of this pool's workers go to its own deque,
+  // everything else to the injection store.
+  //
+  // The deque only holds trivially copyable items, so local tasks are moved
+  // into a heap node; tasks from outside travel by value.
+  void EnqueueImpl(Task task) {
+    Worker *self = current_worker_;
+    if (self != nullptr && self->pool == this) {
+      self->deque.Push(new Task(std::move(task)));
+    } else {
+      injection_store_.Enqueue(std::move(task));
+    }
+  }
+
+  WorkStealingThreadPool(const WorkStealingThreadPool &) = delete;
+  WorkStealingThreadPool &operator=(const WorkStealingThreadPool &) = delete;
+
+private:
+  // How long an idle worker blocks on the injection store before looking at
+  // the other workers' deques again.
+  static constexpr auto kIdleTimeout = std::chrono::milliseconds(1);
+
+  struct Worker {
+    Worker(WorkStealingThreadPool *pool, const size_t index)
+        : pool(pool), rng(0x9E3779B97F4A7C15ull * (index + 1)) {}
+
+    WorkStealingThreadPool *pool;
+    uint64_t rng;
+    ChaseLevDeque<Task *> deque;
+    std::thread thread;
+  };
+
+  static void Run(Task *task) {
+    if (*task) {
+      (*task)();
+    }
+    delete task;
+  }
+
+  // Tries every other worker once, starting from a random victim.
+  Task *Steal(Worker &self) {
+    // xorshift64
+    self.rng ^= self.rng << 13;
+    self.rng ^= self.rng >> 7;
+    self.rng ^= self.rng << 17;
+
+    const size_t start = self.rng % workers_.size();
+    for (size_t i = 0; i < workers_.size(); ++i) {
+      Worker &victim = *workers_[(start + i) % workers_.size()];
+      if (&victim == &self) {
+        continue;
+      }
+      if (auto task = victim.deque.Steal()) {
+        LFWP_METRIC_COUNT("work_stealing.steals", 1);
+        return *task;
+      }
+    }
+    LFWP_METRIC_COUNT("work_stealing.failed_steal_rounds", 1);
+    return nullptr;
+  }
+
+  void Loop(Worker &self) {
+    current_worker_ = &self;
+    Task injected;
+    while (!done_) {
+      if (auto task = self.deque.Pop()) {
+        Run(*task);
+      } else if (injection_store_.WaitDequeueTimed(
+                     injected, std::chrono::microseconds(0))) {
+        if (injected) {
+          injected();
+        }
+      } else if (Task *stolen = Steal(self)) {
+        Run(stolen);
+      } else if (injection_store_.WaitDequeueTimed(injected, kIdleTimeout)) {
+        if (injected) {
+          injected();
+        }
+      }
+      injected.Reset();
+    }
+    current_worker_ = nullptr;
+  }
+
+  static inline thread_local Worker *current_worker_ = nullptr;
+
+  InjectionStore &injection_store_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  size_t num_threads_;
+  std::atomic<bool> done_{false};
+};
+
+} // namespace work_pool